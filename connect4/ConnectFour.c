@@ -1,41 +1,239 @@
+/*
+ * Connect four, played against another human or against the computer.
+ *
+ * Build with:
+ *
+ * cc -O2 -pthread -o ConnectFour ConnectFour.c bitboard.c search.c \
+ *         transposition.c book.c tournament.c solver.c eval.c protocol.c \
+ *         tablebase.c mcts.c record.c dataset.c server.c -lm
+ *
+ * Adding -mpopcnt, or -march=native, lets the compiler count the bits of a
+ * bitboard with one instruction, which makes evaluating positions about
+ * twice as fast.
+ *
+ * The board is 7 columns by 6 rows unless another size is chosen when
+ * building, which gives a separate program for each size:
+ *
+ * cc -O2 -pthread -DCOLS=8 -DROWS=7 -o ConnectFour8x7 ...
+ * cc -O2 -pthread -DCOLS=9 -DROWS=7 -o ConnectFour9x7 ...
+ * cc -O2 -pthread -DCOLS=6 -DROWS=5 -o ConnectFour6x5 ...
+ *
+ * Usage: ConnectFour [-d depth] [-t milliseconds] [-m megabytes] [-b book]
+ *                    [-j threads] [--mcts] [--stats file] [--no-ponder]
+ *                    [--record file] [--no-record] [--exact]
+ *        ConnectFour --build-book book [--book-plies plies] [-d depth] ...
+ *        ConnectFour --bench-threads -j threads [-d depth]
+ *        ConnectFour --bench-weak [-m megabytes]
+ *        ConnectFour --perft depth [--moves moves]
+ *        ConnectFour --analyse [--moves moves] [-d depth] [-t milliseconds]
+ *                    [-m megabytes]
+ *        ConnectFour --selfplay games [--player-a player] [--player-b player]
+ *                    [-j threads] [--log file] [--random-plies plies]
+ *        ConnectFour --solve file [-j threads] [-m megabytes] [--exact]
+ *        ConnectFour --protocol [-d depth] [-t milliseconds] [-j threads] ...
+ *        ConnectFour --build-tablebase file [--tablebase-empty cells]
+ *                    [--moves moves]
+ *        ConnectFour --annotate file [-d depth] [-j threads] [-m megabytes]
+ *        ConnectFour --dataset file [--dataset-size positions]
+ *                    [--dataset-plies min-max] [-d depth] [-j threads]
+ *        ConnectFour --dump-dataset file
+ *        ConnectFour --server socket [--server-games games] [-d depth]
+ *                    [-t milliseconds] [-j threads] [-m megabytes]
+ */
+
+
 #include "c4.h"
 
-int main()
+int main(int argc, char *argv[])
 {
-    int board[ROWS][COLS] = {EMPTY_CELL};
+    Position position;
+    Options options;
+    Engine engine;
+    SearchResult lastSearch = {0};          // computer's most recent search
+    Ponder ponder = {0};                    // search during the human's turn
+    GameRecord record;                      // the game so far
     int currentPlayer = PLAYER_1;           // player 1 moves first
     int opponent = 0;
     bool gameWon = false;                   // did a player connect four?
     bool gameOver = false;                  // did the game end in a draw?
+    bool bookBuilt = false;
+    bool solved = false;
+    bool annotated = false;
+    bool generated = false;
+    bool served = false;
+    bool analysed = false;
+    int col = 0;
+    char heading[BUFFER_SIZE] = {0};        // text above the board
     srand(time(NULL));
+    initEvaluation();
+    initPosition(&position);
+    
+    if (!parseOptions(argc, argv, &options))
+    {
+        displayUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    if (options.startMoves != NULL
+            && !playMoves(&position, options.startMoves))
+    {
+        fprintf(stderr, "Invalid moves: %s\n", options.startMoves);
+        return EXIT_FAILURE;
+    }
+    
+    currentPlayer = playerToMove(&position);
+    
+    if (options.perftDepth > 0)
+    {
+        runPerft(&position, options.perftDepth);
+        return EXIT_SUCCESS;
+    }
+    
+    if (options.dumpDatasetFile != NULL)
+    {
+        return datasetDump(options.dumpDatasetFile, stdout) ? EXIT_SUCCESS
+                : EXIT_FAILURE;
+    }
+    
+    if (options.buildTablebaseFile != NULL)
+    {
+        return tablebaseBuild(options.buildTablebaseFile, &position,
+                options.tablebaseEmpty) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (options.tournament.games > 0)
+    {
+        options.tournament.threads = options.threads;
+        options.tournament.ttSize = options.ttSize;
+        return runTournament(&options.tournament) ? EXIT_SUCCESS
+                : EXIT_FAILURE;
+    }
+    
+    if (!initEngine(&engine, &options))
+    {
+        return EXIT_FAILURE;
+    }
+    
+    if (options.buildBookFile != NULL)
+    {
+        bookBuilt = bookBuild(options.buildBookFile, options.bookPlies,
+                options.depth > 0 ? options.depth : BOOK_DEPTH, &engine);
+        freeEngine(&engine);
+        return bookBuilt ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (options.solveFile != NULL)
+    {
+        solved = runSolve(options.solveFile, &engine, options.threads);
+        freeEngine(&engine);
+        return solved ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (options.annotateFile != NULL)
+    {
+        annotated = annotateFile(options.annotateFile, &engine,
+                options.depth > 0 ? options.depth : ANNOTATE_DEPTH,
+                options.threads);
+        freeEngine(&engine);
+        return annotated ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (options.dataset.path != NULL)
+    {
+        options.dataset.depth = options.depth > 0 ? options.depth
+                : DATASET_DEPTH;
+        options.dataset.threads = options.threads;
+        generated = datasetGenerate(&options.dataset, &engine);
+        freeEngine(&engine);
+        return generated ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (options.analyse)
+    {
+        analysed = runAnalysis(&position, &engine);
+        freeEngine(&engine);
+        return analysed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (options.serverPath != NULL)
+    {
+        served = runServer(options.serverPath, &engine, options.serverGames,
+                options.threads);
+        freeEngine(&engine);
+        return served ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (options.benchThreads)
+    {
+        benchmarkThreads(&engine);
+        freeEngine(&engine);
+        return EXIT_SUCCESS;
+    }
+    
+    if (options.benchWeak)
+    {
+        benchmarkWeak(&engine);
+        freeEngine(&engine);
+        return EXIT_SUCCESS;
+    }
+    
+    if (options.protocol)
+    {
+        runProtocol(&engine, &position);
+        freeEngine(&engine);
+        return EXIT_SUCCESS;
+    }
     
     displayRules();
     opponent = chooseOpponent();
     
+    if (opponent == COMPUTER_MCTS)
+    {
+        engine.useMcts = true;
+    }
+    
+    recordStart(&record, "human", opponent == HUMAN ? "human"
+            : engine.useMcts ? "mcts" : "computer");
+    
+    for (col = 0; options.startMoves != NULL
+            && options.startMoves[col] != '\0'; col++)
+    {
+        recordMove(&record, options.startMoves[col] - '1');
+    }
+    
     /* Game loop */
     do
     {
-        system("clear");                    // wipe the screen
-        
-        printf("Player %d's turn\n\n\n", currentPlayer);
-        displayBoard(board);
+        snprintf(heading, sizeof(heading), "Player %d's turn\n\n\n",
+                currentPlayer);
+        displayBoard(&position, heading);
+        displaySearchResult(&lastSearch);
         
         // if a computer's turn
-        if (opponent == COMPUTER && currentPlayer == PLAYER_2)
+        if (opponent != HUMAN && currentPlayer == PLAYER_2)
         {
-            usleep(SLEEP_TIME);
-            gameWon = computerMove(board, currentPlayer);
+            gameWon = computerMove(&position, &engine, &lastSearch);
+            col = lastSearch.bestMove;
         }
         // if a human's turn
         else
         {
-            gameWon = makeMove(board, currentPlayer);
+            // the Monte Carlo search has no table to fill in advance
+            if (opponent != HUMAN && !engine.useMcts && options.ponder)
+            {
+                startPondering(&ponder, &position, &engine);
+            }
+            
+            gameWon = makeMove(&position, &col);
+            stopPondering(&ponder);
         }
         
+        recordMove(&record, col);
+        
         if (!gameWon)
         {   
             // if no player won, check if the board is full (i.e. game is a tie)
-            gameOver = isBoardFull(board);
+            gameOver = isBoardFull(&position);
             
             if (!gameOver)
             {
@@ -47,50 +245,977 @@ int main()
     while (!gameWon && !gameOver);
     
     
-    system("clear");
-    
     if (gameWon)
     {
-        printf("Player %d wins!\n\n\n", currentPlayer);
+        snprintf(heading, sizeof(heading), "Player %d wins!\n\n\n",
+                currentPlayer);
+    }
+    else
+    {
+        snprintf(heading, sizeof(heading), "It's a tie!\n\n\n");
+    }
+    
+    displayBoard(&position, heading);
+    displaySearchResult(&lastSearch);
+    
+    recordResult(&record, &position, gameWon);
+    
+    if (options.recordFile != NULL
+            && recordSave(options.recordFile, &record))
+    {
+        printf("Game saved to %s\n", options.recordFile);
+    }
+    
+    freeEngine(&engine);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Read the command line options. Options that are not given keep their
+ * default values.
+ *
+ * params:
+ * argc: number of command line arguments
+ * argv: the command line arguments
+ * options: where the settings are stored
+ *
+ * returns:
+ * true if every option was valid, false otherwise
+ */
+bool parseOptions(int argc, char *argv[], Options *options)
+{
+    static const struct option longOptions[] =
+    {
+        {"depth", required_argument, NULL, 'd'},
+        {"time", required_argument, NULL, 't'},
+        {"hash", required_argument, NULL, 'm'},
+        {"threads", required_argument, NULL, 'j'},
+        {"bench-threads", no_argument, NULL, 'S'},
+        {"bench-weak", no_argument, NULL, 'Q'},
+        {"book", required_argument, NULL, 'b'},
+        {"build-book", required_argument, NULL, 'B'},
+        {"book-plies", required_argument, NULL, 'P'},
+        {"perft", required_argument, NULL, 'F'},
+        {"moves", required_argument, NULL, 'M'},
+        {"selfplay", required_argument, NULL, 'G'},
+        {"player-a", required_argument, NULL, 'A'},
+        {"player-b", required_argument, NULL, 'Z'},
+        {"log", required_argument, NULL, 'L'},
+        {"random-plies", required_argument, NULL, 'R'},
+        {"solve", required_argument, NULL, 'V'},
+        {"protocol", no_argument, NULL, 'E'},
+        {"tablebase", required_argument, NULL, 'T'},
+        {"build-tablebase", required_argument, NULL, 'W'},
+        {"tablebase-empty", required_argument, NULL, 'K'},
+        {"mcts", no_argument, NULL, 'C'},
+        {"stats", required_argument, NULL, 'O'},
+        {"no-ponder", no_argument, NULL, 'N'},
+        {"record", required_argument, NULL, 'H'},
+        {"no-record", no_argument, NULL, 'X'},
+        {"annotate", required_argument, NULL, 'Y'},
+        {"exact", no_argument, NULL, 'U'},
+        {"dataset", required_argument, NULL, 'D'},
+        {"dataset-size", required_argument, NULL, 'I'},
+        {"dataset-plies", required_argument, NULL, 'J'},
+        {"dump-dataset", required_argument, NULL, 'q'},
+        {"server", required_argument, NULL, 'k'},
+        {"analyse", no_argument, NULL, 'v'},
+        {"server-games", required_argument, NULL, 'g'},
+        {NULL, 0, NULL, 0}
+    };
+    bool validOptions = true;
+    int option = 0;
+    
+    options->depth = 0;
+    options->thinkTime = THINK_TIME;
+    options->ttSize = DEFAULT_TT_SIZE;
+    options->threads = 1;
+    options->benchThreads = false;
+    options->benchWeak = false;
+    options->bookFile = NULL;
+    options->buildBookFile = NULL;
+    options->bookPlies = BOOK_PLIES;
+    options->perftDepth = 0;
+    options->startMoves = NULL;
+    options->tournament.players[0].type = PLAYER_DEPTH;
+    options->tournament.players[0].value = DEFAULT_DEPTH;
+    options->tournament.players[1].type = PLAYER_RANDOM;
+    options->tournament.players[1].value = 0;
+    options->tournament.games = 0;
+    options->tournament.randomPlies = RANDOM_PLIES;
+    options->tournament.logFile = SELFPLAY_LOG;
+    options->solveFile = NULL;
+    options->protocol = false;
+    options->tablebaseFile = NULL;
+    options->buildTablebaseFile = NULL;
+    options->tablebaseEmpty = TABLEBASE_EMPTY;
+    options->mcts = false;
+    options->statsFile = NULL;
+    options->ponder = true;
+    options->recordFile = GAME_RECORDS;
+    options->annotateFile = NULL;
+    options->exact = false;
+    options->dataset.path = NULL;
+    options->dataset.count = DATASET_SIZE;
+    options->dataset.minPlies = DATASET_MIN_PLIES;
+    options->dataset.maxPlies = DATASET_MAX_PLIES < CELLS ? DATASET_MAX_PLIES
+            : CELLS - 1;
+    options->dumpDatasetFile = NULL;
+    options->serverPath = NULL;
+    options->serverGames = SERVER_GAMES;
+    options->analyse = false;
+    
+    while (validOptions
+            && (option = getopt_long(argc, argv, "d:t:m:j:b:",
+                    longOptions, NULL)) != -1)
+    {
+        switch (option)
+        {
+            case 'd':
+                validOptions = parseOption(optarg, 1, CELLS, "Depth",
+                        &options->depth);
+                break;
+            
+            case 't':
+                validOptions = parseOption(optarg, 0, MAX_THINK_TIME, "Time",
+                        &options->thinkTime);
+                break;
+            
+            case 'm':
+                validOptions = parseOption(optarg, 0, MAX_TT_SIZE, "Table size",
+                        &options->ttSize);
+                break;
+            
+            case 'j':
+                validOptions = parseOption(optarg, 1, MAX_THREADS, "Threads",
+                        &options->threads);
+                break;
+            
+            case 'S':
+                options->benchThreads = true;
+                break;
+            
+            case 'Q':
+                options->benchWeak = true;
+                break;
+            
+            case 'b':
+                options->bookFile = optarg;
+                break;
+            
+            case 'B':
+                options->buildBookFile = optarg;
+                break;
+            
+            case 'P':
+                validOptions = parseOption(optarg, 1, CELLS, "Book plies",
+                        &options->bookPlies);
+                break;
+            
+            case 'F':
+                validOptions = parseOption(optarg, 1, CELLS, "Perft depth",
+                        &options->perftDepth);
+                break;
+            
+            case 'M':
+                options->startMoves = optarg;
+                break;
+            
+            case 'G':
+                validOptions = parseOption(optarg, 1, MAX_GAMES, "Games",
+                        &options->tournament.games);
+                break;
+            
+            case 'A':
+                validOptions = parsePlayerSpec(optarg,
+                        &options->tournament.players[0]);
+                break;
+            
+            case 'Z':
+                validOptions = parsePlayerSpec(optarg,
+                        &options->tournament.players[1]);
+                break;
+            
+            case 'L':
+                options->tournament.logFile = optarg;
+                break;
+            
+            case 'R':
+                validOptions = parseOption(optarg, 0, CELLS - 1,
+                        "Random plies", &options->tournament.randomPlies);
+                break;
+            
+            case 'V':
+                options->solveFile = optarg;
+                break;
+            
+            case 'E':
+                options->protocol = true;
+                break;
+            
+            case 'T':
+                options->tablebaseFile = optarg;
+                break;
+            
+            case 'W':
+                options->buildTablebaseFile = optarg;
+                break;
+            
+            case 'K':
+                validOptions = parseOption(optarg, 1, MAX_TABLEBASE_EMPTY,
+                        "Tablebase empty cells", &options->tablebaseEmpty);
+                break;
+            
+            case 'C':
+                options->mcts = true;
+                break;
+            
+            case 'O':
+                options->statsFile = optarg;
+                break;
+            
+            case 'N':
+                options->ponder = false;
+                break;
+            
+            case 'H':
+                options->recordFile = optarg;
+                break;
+            
+            case 'X':
+                options->recordFile = NULL;
+                break;
+            
+            case 'Y':
+                options->annotateFile = optarg;
+                break;
+            
+            case 'U':
+                options->exact = true;
+                break;
+            
+            case 'D':
+                options->dataset.path = optarg;
+                break;
+            
+            case 'I':
+                validOptions = parseOption(optarg, 1, MAX_DATASET_SIZE,
+                        "Dataset size", &options->dataset.count);
+                break;
+            
+            case 'J':
+                validOptions = parseRange(optarg, 0, CELLS - 1,
+                        "Dataset plies", &options->dataset.minPlies,
+                        &options->dataset.maxPlies);
+                break;
+            
+            case 'q':
+                options->dumpDatasetFile = optarg;
+                break;
+            
+            case 'k':
+                options->serverPath = optarg;
+                break;
+            
+            case 'g':
+                validOptions = parseOption(optarg, 1, MAX_SERVER_GAMES,
+                        "Server games", &options->serverGames);
+                break;
+            
+            case 'v':
+                options->analyse = true;
+                break;
+            
+            default:
+                validOptions = false;
+                break;
+        }
+    }
+    
+    if (optind < argc)
+    {
+        fprintf(stderr, "Unexpected argument: %s\n", argv[optind]);
+        validOptions = false;
+    }
+    
+    return validOptions;
+}
+
+
+/*
+ * Read the integer value of a command line option and check its range.
+ *
+ * Postcondition: the contents at valuePtr are only modified if the value
+ *                is a valid integer in range.
+ *
+ * params:
+ * string: the option value
+ * min: the smallest valid value
+ * max: the largest valid value
+ * name: the name of the setting, for the error message
+ * valuePtr: a pointer to where the value will be stored
+ *
+ * returns:
+ * true if the value was valid, false otherwise
+ */
+bool parseOption(const char *string, long int min, long int max,
+        const char *name, int *valuePtr)
+{
+    bool validValue = false;
+    long int number = 0;            // long int so it can be used in parseInt()
+    
+    if (parseInt(string, &number) && number >= min && number <= max)
+    {
+        *valuePtr = number;
+        validValue = true;
     }
     else
     {
-        printf("It's a tie!\n\n\n");
+        fprintf(stderr, "%s must be in range %ld to %ld\n", name, min, max);
     }
     
-    displayBoard(board);
+    return validValue;
+}
+
+
+/*
+ * Read a range of integer values of a command line option, written as
+ * "MIN-MAX" or as a single value, and check it lies within a range.
+ *
+ * Postcondition: the contents at lowPtr and highPtr are only modified if
+ *                the range is valid.
+ *
+ * params:
+ * string: the option value
+ * min: the smallest valid value
+ * max: the largest valid value
+ * name: the name of the setting, for the error message
+ * lowPtr: a pointer to where the low end of the range will be stored
+ * highPtr: a pointer to where the high end of the range will be stored
+ *
+ * returns:
+ * true if the range was valid, false otherwise
+ */
+bool parseRange(const char *string, long int min, long int max,
+        const char *name, int *lowPtr, int *highPtr)
+{
+    char low[BUFFER_SIZE] = {0};
+    const char *dash = strchr(string, '-');
+    bool validRange = false;
+    long int lowNumber = 0;
+    long int highNumber = 0;
+    
+    if (dash == NULL)
+    {
+        validRange = parseInt(string, &lowNumber);
+        highNumber = lowNumber;
+    }
+    else if ((size_t)(dash - string) < sizeof(low))
+    {
+        memcpy(low, string, dash - string);
+        validRange = parseInt(low, &lowNumber)
+                && parseInt(dash + 1, &highNumber);
+    }
+    
+    validRange = validRange && lowNumber >= min && lowNumber <= highNumber
+            && highNumber <= max;
+    
+    if (validRange)
+    {
+        *lowPtr = lowNumber;
+        *highPtr = highNumber;
+    }
+    else
+    {
+        fprintf(stderr, "%s must be a range within %ld to %ld\n", name, min,
+                max);
+    }
+    
+    return validRange;
+}
+
+
+/*
+ * Show the command line options.
+ *
+ * params:
+ * program: the name the program was run with
+ */
+void displayUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [options]\n\n"
+            "  -d, --depth N    most moves the computer looks ahead "
+            "(default: no limit,\n"
+            "                   or %d when there is no time limit)\n"
+            "  -t, --time MS    time the computer thinks per move, "
+            "0 for no limit\n"
+            "                   (default %d)\n"
+            "  -m, --hash N     transposition table size in megabytes "
+            "(default %d)\n"
+            "  -j, --threads N  threads the computer searches with (default 1)\n"
+            "  --bench-threads  time a fixed set of searches with 1 thread "
+            "and with -j\n"
+            "                   threads (at -d, default %d), and exit\n"
+            "  --bench-weak     time the weak and strong solvers on a fixed "
+            "set of\n"
+            "                   positions, and exit\n"
+            "  -b, --book FILE  play the opening from a book file\n"
+            "  --build-book FILE\n"
+            "                   build an opening book, scoring each position "
+            "with a search\n"
+            "                   at -d (default %d), and exit\n"
+            "  --book-plies N   book covers positions with fewer than N pieces "
+            "(default %d)\n"
+            "  --perft N        count the positions 1 to N moves ahead, "
+            "and exit\n"
+            "  --moves MOVES    start from the position after these columns "
+            "(e.g. 4453)\n"
+            "  --analyse        score every column of the --moves position "
+            "with the -d or\n"
+            "                   -t limits, and exit\n"
+            "  --selfplay N     play N games between players A and B on -j "
+            "threads, and exit\n"
+            "  --player-a P     player A: random, depth:N, time:MS or mcts:MS\n"
+            "                   (default depth:%d)\n"
+            "  --player-b P     player B (default random)\n"
+            "  --log FILE       where tournament games are written "
+            "(default %s)\n"
+            "  --random-plies N random moves opening each tournament game "
+            "(default %d)\n"
+            "  --solve FILE     solve the positions of a file (- for stdin), "
+            "one move\n"
+            "                   string per line, on -j threads, and exit; a "
+            "line may end\n"
+            "                   with strong, exact or weak (win/draw/loss "
+            "only)\n"
+            "  --protocol       read engine commands from stdin instead of "
+            "playing (see\n"
+            "                   protocol.c)\n"
+            "  --tablebase FILE score endgames exactly from a tablebase file\n"
+            "  --build-tablebase FILE\n"
+            "                   build a tablebase of the positions reachable "
+            "from --moves\n"
+            "                   with at most --tablebase-empty empty cells "
+            "(default %d),\n"
+            "                   and exit\n"
+            "  --mcts           the computer plays with Monte Carlo tree "
+            "search (with -t\n"
+            "                   and -j) instead of alpha-beta\n"
+            "  --stats FILE     add a JSON line of search statistics to FILE "
+            "for every\n"
+            "                   computer move\n"
+            "  --no-ponder      do not let the computer search while the "
+            "human thinks\n"
+            "  --record FILE    add every finished game to FILE "
+            "(default %s)\n"
+            "  --no-record      do not save games\n"
+            "  --annotate FILE  score every move of the games of a record "
+            "file (- for\n"
+            "                   stdin) at -d (default %d) on -j threads, mark "
+            "blunders,\n"
+            "                   and exit\n"
+            "  --exact          solve positions exactly with null-window "
+            "searches, in\n"
+            "                   --solve (adding the number of searches to "
+            "each line)\n"
+            "                   and for the computer's moves, which are "
+            "searched with\n"
+            "                   -d and -t instead if they take longer than "
+            "-t (or %d ms)\n"
+            "  --dataset FILE   write random positions labelled by a search "
+            "at -d (default\n"
+            "                   %d) to a binary dataset on -j threads, and "
+            "exit\n"
+            "  --dataset-size N positions in the dataset (default %d)\n"
+            "  --dataset-plies MIN-MAX\n"
+            "                   pieces on the board of dataset positions "
+            "(default %d-%d)\n"
+            "  --dump-dataset FILE\n"
+            "                   write the records of a dataset as text, and "
+            "exit\n"
+            "  --server SOCKET  serve games to clients on a Unix socket, "
+            "searching on -j\n"
+            "                   threads with the -d or -t limits, until "
+            "interrupted\n"
+            "  --server-games N most games the server plays at once "
+            "(default %d)\n",
+            program, DEFAULT_DEPTH, THINK_TIME, DEFAULT_TT_SIZE, BENCH_DEPTH,
+            BOOK_DEPTH, BOOK_PLIES, DEFAULT_DEPTH, SELFPLAY_LOG, RANDOM_PLIES,
+            TABLEBASE_EMPTY, GAME_RECORDS, ANNOTATE_DEPTH, THINK_TIME,
+            DATASET_DEPTH, DATASET_SIZE, DATASET_MIN_PLIES, DATASET_MAX_PLIES,
+            SERVER_GAMES);
+}
+
+
+/*
+ * Count the positions 1, 2, ..., depth moves ahead of a position and show
+ * each count with the number of positions per second it was counted at.
+ *
+ * params:
+ * pos: the starting position
+ * depth: the deepest count
+ */
+void runPerft(Position *pos, int depth)
+{
+    unsigned long long positions = 0;
+    double startTime = 0;
+    double seconds = 0;
+    int d = 0;
+    
+    for (d = 1; d <= depth; d++)
+    {
+        startTime = getTime();
+        positions = perft(pos, d);
+        seconds = getTime() - startTime;
+        
+        printf("Depth %2d: %15llu positions in %8.3f s (%.0f positions/s)\n",
+                d, positions, seconds,
+                seconds > 0 ? positions / seconds : 0.0);
+    }
 }
 
 
 /*
- * Computer player makes a random move.
+ * Score every column of a position and show the scores, best first, with
+ * the line the search expects after the best move.
  *
- * It is assumed that the board is not full, otherwise an infinite loop
- * will occur.
+ * params:
+ * pos: the position, whose board must not be full
+ * engine: the computer player whose limits, table and tablebase are used
+ *
+ * returns:
+ * true if the position was analysed, false if its board is full
+ */
+bool runAnalysis(Position *pos, Engine *engine)
+{
+    Analysis analysis;
+    int order[COLS];
+    int count = 0;
+    int col = 0;
+    int i = 0;
+    
+    if (isBoardFull(pos))
+    {
+        fprintf(stderr, "The board is full\n");
+        return false;
+    }
+    
+    analysePosition(pos, &engine->limits, &engine->tt, &analysis);
+    
+    /* Insertion sort of the playable columns, best score first */
+    for (col = 0; col < COLS; col++)
+    {
+        if (!analysis.playable[col])
+        {
+            continue;
+        }
+        
+        for (i = count; i > 0
+                && analysis.scores[order[i - 1]] < analysis.scores[col]; i--)
+        {
+            order[i] = order[i - 1];
+        }
+        
+        order[i] = col;
+        count++;
+    }
+    
+    printf("Column  Score\n");
+    
+    for (i = 0; i < count; i++)
+    {
+        printf("%6d %6d\n", order[i] + 1, analysis.scores[order[i]]);
+    }
+    
+    printf("\nDepth %d, %llu nodes in %.3f s, best line:",
+            analysis.result.depth, analysis.result.nodes,
+            analysis.result.seconds);
+    
+    for (i = 0; i < analysis.result.pvLength; i++)
+    {
+        printf(" %d", analysis.result.pv[i] + 1);
+    }
+    
+    printf("\n");
+    return true;
+}
+
+
+/*
+ * Solve the positions of a file, or of the standard input, and write their
+ * scores and best moves to the standard output.
  *
  * params:
- * board: the game board
- * currentPlayer: the player making the move
+ * path: the file of positions, or "-" for the standard input
+ * engine: the computer player whose transposition table is used
+ * threads: number of worker threads
+ *
+ * returns:
+ * true if the positions were solved, false otherwise
+ */
+bool runSolve(const char *path, Engine *engine, int threads)
+{
+    FILE *input = stdin;
+    bool solved = false;
+    
+    if (strcmp(path, "-") != 0)
+    {
+        input = fopen(path, "r");
+        
+        if (input == NULL)
+        {
+            perror(path);
+            return false;
+        }
+    }
+    
+    solved = solveStream(input, stdout, &engine->tt, &engine->weak, threads,
+            engine->exact ? SOLVE_EXACT : SOLVE_STRONG);
+    
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    
+    return solved;
+}
+
+
+/*
+ * Set up the computer player: its search limits, its transposition table,
+ * the nodes of its Monte Carlo search and, if they were chosen, its opening
+ * book, endgame tablebase and statistics file. The table of the weak solver
+ * is only allocated when positions are solved or the solvers are timed.
+ * The nodes are allocated whichever search is used, since the player can
+ * still be chosen when the game starts, but their memory is only touched by
+ * a Monte Carlo search.
+ *
+ * The computer searches deeper and deeper until its thinking time runs out.
+ * With no time limit it searches to the chosen depth, or DEFAULT_DEPTH if
+ * none was chosen.
+ *
+ * params:
+ * engine: the computer player to set up
+ * options: the command line settings
+ *
+ * returns:
+ * true if the computer player is ready, false otherwise
+ */
+bool initEngine(Engine *engine, const Options *options)
+{
+    memset(engine, 0, sizeof(*engine));
+    engine->limits.depth = options->depth;
+    engine->limits.timeLimit = options->thinkTime;
+    engine->limits.threads = options->threads;
+    
+    if (engine->limits.timeLimit == 0 && engine->limits.depth == 0)
+    {
+        engine->limits.depth = DEFAULT_DEPTH;
+    }
+    
+    if (!ttInit(&engine->tt, options->ttSize))
+    {
+        fprintf(stderr, "Could not allocate a %d MB transposition table\n",
+                options->ttSize);
+        return false;
+    }
+    
+    if (options->bookFile != NULL
+            && !bookOpen(&engine->book, options->bookFile))
+    {
+        ttFree(&engine->tt);
+        return false;
+    }
+    
+    if (options->tablebaseFile != NULL)
+    {
+        if (!tablebaseOpen(&engine->tablebase, options->tablebaseFile))
+        {
+            bookClose(&engine->book);
+            ttFree(&engine->tt);
+            return false;
+        }
+        
+        engine->limits.tablebase = &engine->tablebase;
+    }
+    
+    /* Only solving positions and timing the weak solver use its table; left
+       empty, it is never probed or stored to */
+    if ((options->solveFile != NULL || options->benchWeak)
+            && !weakTableInit(&engine->weak, options->ttSize))
+    {
+        fprintf(stderr, "Could not allocate a %d MB weak solver table\n",
+                options->ttSize);
+        freeEngine(engine);
+        return false;
+    }
+    
+    if (!mctsInit(&engine->mcts, MCTS_TREE_SIZE, options->threads))
+    {
+        fprintf(stderr, "Could not allocate a %d MB Monte Carlo tree\n",
+                MCTS_TREE_SIZE);
+        freeEngine(engine);
+        return false;
+    }
+    
+    if (options->statsFile != NULL)
+    {
+        engine->statsFile = fopen(options->statsFile, "a");
+        
+        if (engine->statsFile == NULL)
+        {
+            perror(options->statsFile);
+            freeEngine(engine);
+            return false;
+        }
+    }
+    
+    engine->useMcts = options->mcts;
+    engine->exact = options->exact;
+    return true;
+}
+
+
+/*
+ * Release the memory and files used by the computer player.
+ *
+ * params:
+ * engine: the computer player
+ */
+void freeEngine(Engine *engine)
+{
+    ttFree(&engine->tt);
+    bookClose(&engine->book);
+    tablebaseClose(&engine->tablebase);
+    mctsFree(&engine->mcts);
+    weakTableFree(&engine->weak);
+    
+    if (engine->statsFile != NULL)
+    {
+        fclose(engine->statsFile);
+        engine->statsFile = NULL;
+    }
+}
+
+
+/*
+ * Computer player chooses its best move and makes it. The move is taken
+ * from the opening book if the position is in it, otherwise it is searched
+ * with alpha-beta or with Monte Carlo tree search.
+ *
+ * It is assumed that the board is not full.
+ *
+ * params:
+ * pos: the game position
+ * engine: the computer player
+ * result: where the outcome and statistics of the search are stored
  *
  * returns:
  * true if the computer won the game, false otherwise
  */
-bool computerMove(int board[ROWS][COLS], int currentPlayer)
+bool computerMove(Position *pos, Engine *engine, SearchResult *result)
 {
+    SearchLimits solveLimits = engine->limits;
     bool connectedFour = false;
-    unsigned int col = 0;
     
-    do
+    memset(result, 0, sizeof(*result));
+    
+    /* An exact solve gets -t to finish in, or the default time with -d */
+    if (solveLimits.timeLimit == 0)
+    {
+        solveLimits.timeLimit = THINK_TIME;
+    }
+    
+    if (bookLookup(&engine->book, pos, &result->bestMove, &result->score))
+    {
+        result->fromBook = true;
+    }
+    else if (engine->useMcts)
+    {
+        mctsSearch(pos, &engine->mcts, &engine->limits, result);
+    }
+    else if (!engine->exact
+            || !solveNullWindow(pos, &solveLimits, &engine->tt, result))
     {
-        col = rand() % COLS;
+        /* A position too slow to solve in time is searched instead */
+        searchPosition(pos, &engine->limits, &engine->tt, result);
     }
-    while (board[TOP_ROW][col] != EMPTY_CELL);      // while column is full
     
-    connectedFour = placePiece(board, col, currentPlayer);
+    if (engine->statsFile != NULL)
+    {
+        writeSearchStats(engine->statsFile, pos, result);
+    }
+    
+    connectedFour = placePiece(pos, result->bestMove);
     return connectedFour;
 }
 
 
+/*
+ * Show the statistics of the computer's last search, if there was one.
+ *
+ * params:
+ * result: the outcome of the search
+ */
+void displaySearchResult(const SearchResult *result)
+{
+    double nodesPerSecond = 0;
+    double hitRate = 0;
+    double collisionRate = 0;
+    double firstCutoffRate = 0;
+    double playoutsPerSecond = 0;
+    
+    if (result->fromBook)
+    {
+        printf("Computer played column %d from the opening book (score %d)"
+                "\n\n", result->bestMove + 1, result->score);
+    }
+    else if (result->playouts > 0)
+    {
+        if (result->seconds > 0)
+        {
+            playoutsPerSecond = result->playouts / result->seconds;
+        }
+        
+        printf("Computer played column %d (won %.1f%% of playouts, tree depth "
+                "%d)\n"
+                "Ran %llu playouts in %.3f s (%.0f playouts/s), %llu tree "
+                "nodes\n\n",
+                result->bestMove + 1, result->score / 10.0, result->depth,
+                result->playouts, result->seconds, playoutsPerSecond,
+                result->nodes);
+    }
+    else if (result->nodes > 0)
+    {
+        if (result->seconds > 0)
+        {
+            nodesPerSecond = result->nodes / result->seconds;
+        }
+        
+        if (result->ttProbes > 0)
+        {
+            hitRate = 100.0 * result->ttHits / result->ttProbes;
+            collisionRate = 100.0 * result->ttCollisions / result->ttProbes;
+        }
+        
+        if (result->cutoffs > 0)
+        {
+            firstCutoffRate = 100.0 * result->firstCutoffs / result->cutoffs;
+        }
+        
+        printf("Computer played column %d (score %d, depth %d)\n"
+                "Searched %llu nodes in %.3f s (%.0f nodes/s)\n"
+                "Table: %llu probes, %.1f%% hits, %.1f%% collisions\n"
+                "Ordering: %.1f%% first-move cutoffs, branching factor %.2f"
+                "\n",
+                result->bestMove + 1, result->score, result->depth,
+                result->nodes, result->seconds, nodesPerSecond,
+                result->ttProbes, hitRate, collisionRate, firstCutoffRate,
+                result->branchingFactor);
+        
+        if (result->tbHits > 0)
+        {
+            printf("Tablebase: %llu positions scored exactly\n",
+                    result->tbHits);
+        }
+        
+        if (result->researches > 0)
+        {
+            printf("Solved exactly with %d null-window searches\n",
+                    result->researches);
+        }
+        
+        printf("\n");
+    }
+}
+
+
+/*
+ * Write the statistics of a computer move as one line of JSON, and flush it
+ * so the line can be read while the game goes on. The line holds:
+ *
+ * ply, move, score and source ("book", "search", "exact" or "mcts") always;
+ * for a search, the depth reached, nodes, nodes per second, seconds, table
+ * probes, hits and collisions, tablebase hits, cutoffs, first-move cutoffs,
+ * branching factor, the milliseconds of each completed iteration and the
+ * principal variation; for an exact solve, the same but for the branching
+ * factor, iterations and variation, which it does not have, and with the
+ * number of null-window searches; for a Monte Carlo search, the depth,
+ * nodes, seconds, playouts and playouts per second. Moves count from 1, and
+ * the ply is the number of pieces on the board before the move.
+ *
+ * params:
+ * file: where the line is written
+ * pos: the position the move was chosen in
+ * result: the outcome and statistics of choosing the move
+ */
+void writeSearchStats(FILE *file, const Position *pos,
+        const SearchResult *result)
+{
+    double perSecond = 0;
+    int i = 0;
+    
+    fprintf(file, "{\"ply\":%u,\"move\":%d,\"score\":%d,\"source\":\"%s\"",
+            pos->moves, result->bestMove + 1, result->score,
+            result->fromBook ? "book"
+                : result->playouts > 0 ? "mcts"
+                : result->researches > 0 ? "exact" : "search");
+    
+    if (result->seconds > 0)
+    {
+        perSecond = (result->playouts > 0 ? result->playouts : result->nodes)
+                / result->seconds;
+    }
+    
+    if (result->playouts > 0)
+    {
+        fprintf(file, ",\"depth\":%d,\"nodes\":%llu,\"seconds\":%.6f,"
+                "\"playouts\":%llu,\"playouts_per_second\":%.0f",
+                result->depth, result->nodes, result->seconds,
+                result->playouts, perSecond);
+    }
+    else if (!result->fromBook)
+    {
+        fprintf(file, ",\"depth\":%d,\"nodes\":%llu,\"nps\":%.0f,"
+                "\"seconds\":%.6f,\"tt_probes\":%llu,\"tt_hits\":%llu,"
+                "\"tt_collisions\":%llu,\"tb_hits\":%llu,\"cutoffs\":%llu,"
+                "\"first_cutoffs\":%llu",
+                result->depth, result->nodes, perSecond, result->seconds,
+                result->ttProbes, result->ttHits, result->ttCollisions,
+                result->tbHits, result->cutoffs, result->firstCutoffs);
+    }
+    
+    if (result->researches > 0)
+    {
+        fprintf(file, ",\"null_window_searches\":%d", result->researches);
+    }
+    else if (!result->fromBook && result->playouts == 0)
+    {
+        fprintf(file, ",\"branching_factor\":%.3f,\"iteration_ms\":[",
+                result->branchingFactor);
+        
+        for (i = 0; i < result->depth; i++)
+        {
+            fprintf(file, "%s%.3f", i > 0 ? "," : "",
+                    result->iterationSeconds[i] * 1000);
+        }
+        
+        fprintf(file, "],\"pv\":[");
+        
+        for (i = 0; i < result->pvLength; i++)
+        {
+            fprintf(file, "%s%d", i > 0 ? "," : "", result->pv[i] + 1);
+        }
+        
+        fprintf(file, "]");
+    }
+    
+    fprintf(file, "}\n");
+    fflush(file);
+}
+
+
 /*
  * Prompt the user to choose a column to drop their piece in.
  * The user is continually prompted until a valid input is made.
@@ -103,13 +1228,13 @@ bool computerMove(int board[ROWS][COLS], int currentPlayer)
  * that must be discarded manually.
  *
  * params:
- * board: the game board
- * currentPlayer: the player making the move
+ * pos: the game position
+ * colPtr: where the column chosen is stored
  *
  * returns:
  * true if the player won the game, false otherwise
  */
-bool makeMove(int board[ROWS][COLS], int currentPlayer)
+bool makeMove(Position *pos, int *colPtr)
 {
     bool connectedFour = false;
     long int choice = 0;            // long int so it can be used in parseInt()
@@ -147,7 +1272,7 @@ bool makeMove(int board[ROWS][COLS], int currentPlayer)
                         col = choice - 1;   // subtract 1 for valid indexing
                         
                         // make sure the column is not already full
-                        if (board[TOP_ROW][col] == EMPTY_CELL)
+                        if (canPlay(pos, col))
                         {
                             validChoice = true;
                         }
@@ -166,232 +1291,137 @@ bool makeMove(int board[ROWS][COLS], int currentPlayer)
     }
     while (!validChoice);
     
-    connectedFour = placePiece(board, col, currentPlayer);
+    *colPtr = col;
+    connectedFour = placePiece(pos, col);
     return connectedFour;
 }
 
 
 /*
- * Place a player piece in the board at the specified column, and at the
- * next available row. If the column is full, the board will not be modified.
- *
- * If a game piece is placed, check if that addition to the game board made
- * four in a row for the current player.
- *
- * params:
- * board: the game board
- * col: the column to place a piece in
- * currentPlayer: the current player
- *
- * returns:
- * true if four in a row was made, false otherwise
- */
-bool placePiece(int board[ROWS][COLS], int col, int currentPlayer)
-{
-    bool connectedFour = false;
-    bool emptyCellFound = false;
-    int cellValue = 0;
-    unsigned int row = 0;
-    
-    /* Start searching from the bottom of the column for an empty cell */
-    for (row = ROWS - 1; row >= 0 && !emptyCellFound; row--)
-    {
-        if (board[row][col] == EMPTY_CELL)
-        {
-            emptyCellFound = true;
-        }
-    }
-    
-    if (emptyCellFound)
-    {
-        row++;      // row was subtracted one extra at the end of the for loop
-        
-        if (currentPlayer == PLAYER_1)
-        {
-            cellValue = PLAYER_1_CELL;
-        }
-        else
-        {
-            cellValue = PLAYER_2_CELL;
-        }
-        
-        board[row][col] = cellValue;
-        
-        /* Only need to check if they add to 3, since current row and column
-           counts as 1 */
-        connectedFour =
-                // check vertical four in a row
-                (count(board, row + 1, col, 1, 0, cellValue)
-                    + count(board, row - 1, col, -1, 0, cellValue) == 3)
-                // check horizontal four in a row
-                || (count(board, row, col + 1, 0, 1, cellValue)
-                    + count(board, row, col - 1, 0, -1, cellValue) == 3)
-                // check left diagonal four in a row
-                || (count(board, row + 1, col + 1, 1, 1, cellValue)
-                    + count(board, row - 1, col - 1, -1, -1, cellValue) == 3)
-                // check right diagonal four in a row
-                || (count(board, row + 1, col - 1, 1, -1, cellValue)
-                    + count(board, row -1, col + 1, -1, 1, cellValue) == 3);
-    }
-    
-    return connectedFour;
-}
-
-
-/*
- * Recursive function to count number of pieces in a row.
+ * Set the current player to the next player.
  *
  * params:
- * board: the game board
- * row: the current row in the game board
- * col: the current column in the game board
- * rowAdd: used to get the next row to check in the game board
- * colAdd: used to get the next row to check in the game board
- * cellValue: the player piece that is being counted
- *
- * returns:
- * number of player pieces found in a row
+ * currentPlayerPtr: a pointer to the current player
  */
-int count(int board[ROWS][COLS], int row, int col,
-        int rowAdd, int colAdd, int cellValue)
+void switchPlayer(int *currentPlayerPtr)
 {
-    // check for out of bounds indices
-    if (row < 0 || row >= ROWS || col < 0 || col >= COLS)
-    {
-        return 0;
-    }
-    else if (board[row][col] != cellValue)
+    if (*currentPlayerPtr == PLAYER_1)
     {
-        return 0;
+        *currentPlayerPtr = PLAYER_2;
     }
     else
     {
-        return 1 + count(board, row + rowAdd, col + colAdd,
-                rowAdd, colAdd, cellValue);
+        *currentPlayerPtr = PLAYER_1;
     }
 }
 
 
 /*
- * Determine if the board is full.
- *
- * Since the board must be filled bottom up (since gravity), only
- * need to check if the entire top row of the board is full.
+ * Add text to the end of a frame. The rest of the screen line is erased
+ * before each line break, so nothing of the previous frame shows through.
+ * Text that does not fit in the frame is dropped.
  *
  * params:
- * board: the game board
+ * frame: the frame, FRAME_SIZE bytes long
+ * length: the length of the frame so far, updated with the added text
+ * text: the text to add
  */
-bool isBoardFull(int board[ROWS][COLS])
+void appendText(char *frame, size_t *length, const char *text)
 {
-    bool isFull = true;
-    unsigned int col = 0;
+    size_t eraseLength = strlen(ERASE_LINE);
     
-    for (col = 0; col < COLS && isFull; col++)
+    for (; *text != '\0' && *length + eraseLength < FRAME_SIZE; text++)
     {
-        if (board[TOP_ROW][col] == EMPTY_CELL)
+        if (*text == '\n')
         {
-            isFull = false;
+            memcpy(frame + *length, ERASE_LINE, eraseLength);
+            *length += eraseLength;
         }
-    }
-    
-    return isFull;
-}
-
-
-/*
- * Set the current player to the next player.
- *
- * params:
- * currentPlayerPtr: a pointer to the current player
- */
-void switchPlayer(int *currentPlayerPtr)
-{
-    if (*currentPlayerPtr == PLAYER_1)
-    {
-        *currentPlayerPtr = PLAYER_2;
-    }
-    else
-    {
-        *currentPlayerPtr = PLAYER_1;
+        
+        frame[(*length)++] = *text;
     }
 }
 
 
 /*
- * Display the connect four game board with its pieces.
+ * Display the connect four game board with its pieces, below a heading.
  * The column numbers are labeled above the game board.
  *
+ * The whole screen is drawn into one buffer and written at once, starting
+ * from the top left corner, over the previous screen. Drawing over it
+ * instead of clearing it first means the screen never flickers.
+ *
  * params:
- * board: the game board
+ * pos: the game position
+ * heading: the text to show above the board
  */
-void displayBoard(int board[ROWS][COLS])
+void displayBoard(const Position *pos, const char *heading)
 {
+    static char frame[FRAME_SIZE];          // preallocated screen buffer
+    static const char *pieces[] =
+    {
+        "   ",                                  // EMPTY_CELL
+        COLOR_BLUE "O  " COLOR_RESET,           // PLAYER_1_CELL
+        COLOR_RED "O  " COLOR_RESET             // PLAYER_2_CELL
+    };
+    char label[] = "1     ";
+    size_t length = 0;
+    size_t offset = 0;
+    ssize_t written = 0;
     unsigned int row = 0;
     unsigned int col = 0;
     
-    printf("   ");
+    appendText(frame, &length, CURSOR_HOME);
+    appendText(frame, &length, heading);
+    appendText(frame, &length, "   ");
+    
     for (col = 0; col < COLS; col++)
     {
-        printf("%d     ", col + 1);
+        label[0] = '1' + col;
+        appendText(frame, &length, label);
     }
-    printf("\n");
+    appendText(frame, &length, "\n");
     
     for (col = 0; col < COLS; col++)
     {
-        printf(" _____");
+        appendText(frame, &length, " _____");
     }
-    printf("\n");
+    appendText(frame, &length, "\n");
     
     for (row = 0; row < ROWS; row++)
     {
         for (col = 0; col < COLS; col++)
         {
-            printf("|     ");
+            appendText(frame, &length, "|     ");
         }
-        printf("|\n");
+        appendText(frame, &length, "|\n");
         
         for (col = 0; col < COLS; col++)
         {
-            printf("|  ");
-            
-            if (board[row][col] == PLAYER_1_CELL)
-            {
-                printColor(COLOR_BLUE);
-                printf("O  ");
-                printColor(COLOR_RESET);
-            }
-            else if (board[row][col] == PLAYER_2_CELL)
-            {
-                printColor(COLOR_RED);
-                printf("O  ");
-                printColor(COLOR_RESET);
-            }
-            else
-            {
-                printf("   ");
-            }
+            appendText(frame, &length, "|  ");
+            appendText(frame, &length, pieces[getCell(pos, row, col)]);
         }
-        printf("|\n");
+        appendText(frame, &length, "|\n");
         
         for (col = 0; col < COLS; col++)
         {
-            printf("|_____");
+            appendText(frame, &length, "|_____");
+        }
+        appendText(frame, &length, "|\n");
+    }
+    appendText(frame, &length, "\n\n" ERASE_BELOW);
+    
+    fflush(stdout);                         // earlier output goes first
+    
+    for (offset = 0; offset < length; offset += written)
+    {
+        written = write(STDOUT_FILENO, frame + offset, length - offset);
+        
+        if (written < 0)
+        {
+            break;
         }
-        printf("|\n");
     }
-    printf("\n\n");
-}
-
-
-/*
- * Print an ANSI color code.
- *
- * params:
- * colorString: the color code to printColor
- */
-void printColor(char *colorString)
-{
-    printf(colorString);
 }
 
 
@@ -407,7 +1437,7 @@ void printColor(char *colorString)
  * that must be discarded manually.
  *
  * returns:
- * the user's choice (will be either HUMAN or COMPUTER)
+ * the user's choice (will be HUMAN, COMPUTER or COMPUTER_MCTS)
  */
 int chooseOpponent()
 {
@@ -417,8 +1447,9 @@ int chooseOpponent()
     char *returnPtr = NULL;
     unsigned int inputLen = 0;
     
-    printf("Choose an opponent:\n%d - human\n%d - computer\n\n",
-            HUMAN, COMPUTER);
+    printf("Choose an opponent:\n%d - human\n%d - computer\n"
+            "%d - computer (Monte Carlo tree search)\n\n",
+            HUMAN, COMPUTER, COMPUTER_MCTS);
     
     do
     {
@@ -440,13 +1471,14 @@ int chooseOpponent()
                 // if user input is a valid integer
                 if (parseInt(input, &choice))
                 {
-                    if (choice == HUMAN || choice == COMPUTER)
+                    if (choice >= HUMAN && choice <= COMPUTER_MCTS)
                     {
                         validChoice = true;
                     }
                     else
                     {
-                        printf("Integer must be %d or %d\n", HUMAN, COMPUTER);
+                        printf("Integer must be %d to %d\n", HUMAN,
+                                COMPUTER_MCTS);
                     }
                 }
             }
@@ -0,0 +1,506 @@
+/*
+ * Bitboard representation of a connect four position.
+ *
+ * Each player's pieces are packed into the bits of a bitboard_t (see c4.h for
+ * the bit layout), and the number of pieces in each column is kept alongside
+ * so that the next free cell of a column is known without scanning it.
+ * Placing a piece is a single OR, and checking for four in a row is a handful
+ * of shifts and ANDs per direction.
+ *
+ * Functions taking a column expect it to be in range 0 to COLS - 1.
+ *
+ * The board size is fixed when building, so every shift and mask below is a
+ * constant and the compiler specialises the code for the chosen size.
+ */
+
+
+#include "c4.h"
+
+
+/*
+ * Get the bit of the next free cell in a column.
+ *
+ * params:
+ * pos: the position
+ * col: the column
+ *
+ * returns:
+ * the bitboard with only the next free cell of the column set
+ */
+static inline bitboard_t moveBit(const Position *pos, int col)
+{
+    return (bitboard_t)1 << (col * BOARD_HEIGHT + pos->height[col]);
+}
+
+
+/*
+ * Set a position to the empty board with player 1 to move.
+ *
+ * params:
+ * pos: the position to initialize
+ */
+void initPosition(Position *pos)
+{
+    memset(pos, 0, sizeof(*pos));
+}
+
+
+/*
+ * Determine if a column has room for another piece.
+ *
+ * params:
+ * pos: the position
+ * col: the column to check
+ *
+ * returns:
+ * true if a piece can be placed in the column, false otherwise
+ */
+bool canPlay(const Position *pos, int col)
+{
+    return pos->height[col] < ROWS;
+}
+
+
+/*
+ * Determine if the player to move would make four in a row by placing a
+ * piece in a column. The column must not be full.
+ *
+ * params:
+ * pos: the position
+ * col: the column to check
+ *
+ * returns:
+ * true if the move wins the game, false otherwise
+ */
+bool isWinningMove(const Position *pos, int col)
+{
+    return hasFourInARow(pos->pieces[pos->moves & 1] | moveBit(pos, col));
+}
+
+
+/*
+ * Place a piece for the player to move in a column. The column must not be
+ * full; use placePiece() when that has not already been checked.
+ *
+ * params:
+ * pos: the position
+ * col: the column to place a piece in
+ */
+void playMove(Position *pos, int col)
+{
+    pos->pieces[pos->moves & 1] |= moveBit(pos, col);
+    pos->height[col]++;
+    pos->moves++;
+}
+
+
+/*
+ * Take back the last piece placed in a column. The column must be the one
+ * most recently played with playMove().
+ *
+ * params:
+ * pos: the position
+ * col: the column to take a piece from
+ */
+void undoMove(Position *pos, int col)
+{
+    pos->moves--;
+    pos->height[col]--;
+    pos->pieces[pos->moves & 1] &= ~moveBit(pos, col);
+}
+
+
+/*
+ * Place a piece for the player to move in the specified column, at the next
+ * available row. If the column is full, the position will not be modified.
+ *
+ * params:
+ * pos: the position
+ * col: the column to place a piece in
+ *
+ * returns:
+ * true if four in a row was made, false otherwise
+ */
+bool placePiece(Position *pos, int col)
+{
+    bool connectedFour = false;
+
+    if (canPlay(pos, col))
+    {
+        connectedFour = isWinningMove(pos, col);
+        playMove(pos, col);
+    }
+
+    return connectedFour;
+}
+
+
+/*
+ * Determine if the board is full.
+ *
+ * params:
+ * pos: the position
+ *
+ * returns:
+ * true if every cell holds a piece, false otherwise
+ */
+bool isBoardFull(const Position *pos)
+{
+    return pos->moves == CELLS;
+}
+
+
+/*
+ * Play a sequence of moves, given as a string of column numbers starting
+ * at 1 (for example "4453"). Playing stops at the first move that is not
+ * a digit for a column, is in a full column, or would end the game, since
+ * the position after it would not be one a player still has to move in.
+ *
+ * params:
+ * pos: the position to play the moves in
+ * moves: the column numbers
+ *
+ * returns:
+ * true if every move was played, false otherwise
+ */
+bool playMoves(Position *pos, const char *moves)
+{
+    int col = 0;
+
+    for (; *moves != '\0'; moves++)
+    {
+        col = *moves - '1';
+
+        if (col < 0 || col >= COLS || !canPlay(pos, col)
+                || isWinningMove(pos, col) || pos->moves == CELLS - 1)
+        {
+            return false;
+        }
+
+        playMove(pos, col);
+    }
+
+    return true;
+}
+
+
+/*
+ * Get the contents of a cell, using the same row numbering as the displayed
+ * board (row TOP_ROW is the top of the board).
+ *
+ * params:
+ * pos: the position
+ * row: the row of the cell
+ * col: the column of the cell
+ *
+ * returns:
+ * EMPTY_CELL, PLAYER_1_CELL or PLAYER_2_CELL
+ */
+int getCell(const Position *pos, int row, int col)
+{
+    bitboard_t bit = (bitboard_t)1 << (col * BOARD_HEIGHT + (ROWS - 1 - row));
+    int cellValue = EMPTY_CELL;
+
+    if (pos->pieces[0] & bit)
+    {
+        cellValue = PLAYER_1_CELL;
+    }
+    else if (pos->pieces[1] & bit)
+    {
+        cellValue = PLAYER_2_CELL;
+    }
+
+    return cellValue;
+}
+
+
+/*
+ * Get the player whose turn it is.
+ *
+ * params:
+ * pos: the position
+ *
+ * returns:
+ * PLAYER_1 or PLAYER_2
+ */
+int playerToMove(const Position *pos)
+{
+    return (pos->moves & 1) ? PLAYER_2 : PLAYER_1;
+}
+
+
+/*
+ * Fold the key of a position into 64 bits.
+ *
+ * params:
+ * key: the key, as a bitboard
+ *
+ * returns:
+ * the key in 64 bits
+ */
+static inline uint64_t foldKey(bitboard_t key)
+{
+#if COLS * (ROWS + 1) > 64
+    return (uint64_t)key ^ ((uint64_t)(key >> 64) * 0x9e3779b97f4a7c15ULL);
+#else
+    return key;
+#endif
+}
+
+
+/*
+ * Get a 64-bit key that identifies a position.
+ *
+ * The pieces of the player to move are added to a mask of all occupied cells
+ * plus the bottom row: in every column the carry lands just above the top
+ * piece, and the bits below it are the pieces of the player to move. That
+ * mask is unique to the position. On boards that need more than 64 bits it
+ * is folded into 64 bits, so two positions may then share a key, though
+ * with a tiny chance.
+ *
+ * params:
+ * pos: the position
+ *
+ * returns:
+ * the position key
+ */
+uint64_t positionKey(const Position *pos)
+{
+    bitboard_t occupied = pos->pieces[0] | pos->pieces[1];
+
+    return foldKey(pos->pieces[pos->moves & 1] + occupied + BOTTOM_MASK);
+}
+
+
+/*
+ * Pack a position into 64 bits, for boards of at most 64 bitboard bits (see
+ * PACKED_POSITIONS). The packed position is the key of positionKey() before
+ * any folding, so unpackPosition() can turn it back into the position.
+ *
+ * params:
+ * pos: the position
+ *
+ * returns:
+ * the packed position
+ */
+uint64_t packPosition(const Position *pos)
+{
+    bitboard_t occupied = pos->pieces[0] | pos->pieces[1];
+
+    return (uint64_t)(pos->pieces[pos->moves & 1] + occupied + BOTTOM_MASK);
+}
+
+
+/*
+ * Unpack a position packed by packPosition().
+ *
+ * The highest set bit of each column of a packed position marks the top of
+ * the column, and the bits below it are the pieces of the player to move;
+ * the rest of the column holds the opponent's pieces. The player to move is
+ * known from the number of pieces, so the position is checked to have as
+ * many of their pieces as it should.
+ *
+ * params:
+ * packed: the packed position
+ * pos: where the position is stored
+ *
+ * returns:
+ * true if the packed position is valid, false otherwise
+ */
+bool unpackPosition(uint64_t packed, Position *pos)
+{
+    const bitboard_t column = ((bitboard_t)1 << BOARD_HEIGHT) - 1;
+    bitboard_t key = packed;
+    bitboard_t bits = 0;
+    bitboard_t own = 0;
+    bitboard_t occupied = 0;
+    int ownCount = 0;
+    int height = 0;
+    int col = 0;
+
+    initPosition(pos);
+
+    if (!PACKED_POSITIONS || (key & ~(BOTTOM_MASK * column)) != 0)
+    {
+        return false;
+    }
+
+    for (col = 0; col < COLS; col++)
+    {
+        bits = (key >> (col * BOARD_HEIGHT)) & column;
+
+        if (bits == 0)
+        {
+            return false;
+        }
+
+        height = ROWS;
+
+        while ((bits >> height) == 0)
+        {
+            height--;
+        }
+
+        bits ^= (bitboard_t)1 << height;
+        ownCount += __builtin_popcount((unsigned int)bits);
+        own |= bits << (col * BOARD_HEIGHT);
+        occupied |= (((bitboard_t)1 << height) - 1) << (col * BOARD_HEIGHT);
+        pos->height[col] = height;
+        pos->moves += height;
+    }
+
+    if (ownCount != (int)pos->moves / 2)
+    {
+        initPosition(pos);
+        return false;
+    }
+
+    pos->pieces[pos->moves & 1] = own;
+    pos->pieces[(pos->moves & 1) ^ 1] = occupied ^ own;
+
+    return true;
+}
+
+
+/*
+ * Reverse the order of the columns of a bitboard, which mirrors it from
+ * left to right.
+ *
+ * params:
+ * bits: the bitboard
+ *
+ * returns:
+ * the mirrored bitboard
+ */
+static inline bitboard_t mirrorBitboard(bitboard_t bits)
+{
+    const bitboard_t column = ((bitboard_t)1 << BOARD_HEIGHT) - 1;
+    bitboard_t mirrored = 0;
+    int col = 0;
+
+    for (col = 0; col < COLS; col++)
+    {
+        mirrored |= ((bits >> (col * BOARD_HEIGHT)) & column)
+                << ((COLS - 1 - col) * BOARD_HEIGHT);
+    }
+
+    return mirrored;
+}
+
+
+/*
+ * Get a 64-bit key shared by a position and its mirror image, since the
+ * mirror image of a position is worth the same and its best move is the
+ * mirror image of the best move. Tables that store positions under this key
+ * hold one entry for both.
+ *
+ * The key of positionKey() is made one column at a time, so mirroring it
+ * gives the key of the mirror image, and the smaller of the two is taken.
+ *
+ * params:
+ * pos: the position
+ * mirrored: where true is stored if the key is the mirror image's, so that
+ *           moves stored with it must be mirrored, or NULL
+ *
+ * returns:
+ * the position key
+ */
+uint64_t canonicalKey(const Position *pos, bool *mirrored)
+{
+    bitboard_t occupied = pos->pieces[0] | pos->pieces[1];
+    bitboard_t key = pos->pieces[pos->moves & 1] + occupied + BOTTOM_MASK;
+    bitboard_t mirrorKey = mirrorBitboard(key);
+    bool useMirror = mirrorKey < key;
+
+    if (mirrored != NULL)
+    {
+        *mirrored = useMirror;
+    }
+
+    return foldKey(useMirror ? mirrorKey : key);
+}
+
+
+/*
+ * Determine if a set of pieces contains four in a row.
+ *
+ * For each direction the set is ANDed with itself shifted by one step, which
+ * leaves the pieces that start a line of two; repeating that with a shift of
+ * two steps leaves the pieces that start a line of four.
+ *
+ * params:
+ * pieces: the pieces of one player
+ *
+ * returns:
+ * true if four in a row is found, false otherwise
+ */
+bool hasFourInARow(bitboard_t pieces)
+{
+    static const int steps[] =
+    {
+        1,                  // vertical
+        BOARD_HEIGHT,       // horizontal
+        BOARD_HEIGHT - 1,   // diagonal going down to the right
+        BOARD_HEIGHT + 1    // diagonal going up to the right
+    };
+    bitboard_t pairs = 0;
+    unsigned int i = 0;
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+    {
+        pairs = pieces & (pieces >> steps[i]);
+
+        if (pairs & (pairs >> (2 * steps[i])))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*
+ * Count the positions reached by playing every sequence of a given number
+ * of moves (a "perft" count). A move that wins the game ends its sequence,
+ * so the winning position is only counted if it is at the last move.
+ *
+ * The counts for small depths are known, so this checks the move and win
+ * detection code, and timing it measures their speed.
+ *
+ * params:
+ * pos: the starting position, restored before returning
+ * depth: number of moves to play
+ *
+ * returns:
+ * the number of positions reached
+ */
+unsigned long long perft(Position *pos, int depth)
+{
+    unsigned long long positions = 0;
+    int col = 0;
+
+    if (depth == 0)
+    {
+        return 1;
+    }
+
+    for (col = 0; col < COLS; col++)
+    {
+        if (canPlay(pos, col))
+        {
+            if (isWinningMove(pos, col))
+            {
+                positions += (depth == 1);
+            }
+            else
+            {
+                playMove(pos, col);
+                positions += perft(pos, depth - 1);
+                undoMove(pos, col);
+            }
+        }
+    }
+
+    return positions;
+}
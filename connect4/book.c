@@ -0,0 +1,364 @@
+/*
+ * Opening book for the computer player.
+ *
+ * The book maps the key of every position reachable in the first few moves
+ * of a game to the best move found for it by an offline search. A position
+ * and its mirror image share a key and an entry, whose move is the move of
+ * the one the key belongs to, so the book holds about half the positions it
+ * otherwise would. The file holds a header, then the position keys in
+ * ascending order, then the packed move and score of each key in the same
+ * order:
+ *
+ * BookHeader | uint64_t keys[count] | uint16_t values[count]
+ *
+ * A value packs the move into its low BOOK_MOVE_BITS bits and the score,
+ * as a signed number, into the remaining bits.
+ *
+ * The engine maps the file into memory instead of reading it, so opening a
+ * book costs the same whatever its size, and a lookup is a binary search
+ * that only touches the pages it needs. All multi-byte fields are stored in
+ * the byte order of the machine that built the book.
+ */
+
+
+#include "c4.h"
+
+
+#define BOOK_MAGIC "C4BK"       // identifies an opening book file
+#define BOOK_VERSION 2          // version of the book file layout
+#define BOOK_MOVE_BITS 4        // bits of a value that hold the move
+
+
+/* Start of an opening book file */
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;                  // board size the book was built for
+    uint32_t cols;
+    uint32_t plies;                 // book holds positions with fewer pieces
+    uint32_t reserved;
+    uint64_t count;                 // number of positions in the book
+}
+BookHeader;
+
+
+/*
+ * Order two positions by their position key, for qsort().
+ *
+ * params:
+ * a: the first position
+ * b: the second position
+ *
+ * returns:
+ * a negative number, zero or a positive number if the key of the first
+ * position is less than, equal to or greater than the key of the second
+ */
+static int comparePositions(const void *a, const void *b)
+{
+    uint64_t keyA = canonicalKey((const Position *)a, NULL);
+    uint64_t keyB = canonicalKey((const Position *)b, NULL);
+
+    return (keyA > keyB) - (keyA < keyB);
+}
+
+
+/*
+ * Open a book file and map it into memory.
+ *
+ * params:
+ * book: the book to open
+ * path: the book file
+ *
+ * returns:
+ * true if the book was opened, false otherwise
+ */
+bool bookOpen(Book *book, const char *path)
+{
+    const BookHeader *header = NULL;
+    struct stat fileInfo;
+    size_t expectedSize = 0;
+    void *map = MAP_FAILED;
+    int fd = -1;
+
+    memset(book, 0, sizeof(*book));
+
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    if (fstat(fd, &fileInfo) == 0
+            && (size_t)fileInfo.st_size >= sizeof(BookHeader))
+    {
+        map = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);                  // the mapping stays valid without the file
+
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: not an opening book\n", path);
+        return false;
+    }
+
+    header = (const BookHeader *)map;
+    expectedSize = sizeof(BookHeader) + header->count
+            * (sizeof(uint64_t) + sizeof(uint16_t));
+
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0
+            || header->version != BOOK_VERSION
+            || header->rows != ROWS || header->cols != COLS
+            || (size_t)fileInfo.st_size != expectedSize)
+    {
+        fprintf(stderr, "%s: not an opening book for a %dx%d board\n",
+                path, COLS, ROWS);
+        munmap(map, fileInfo.st_size);
+        return false;
+    }
+
+    book->map = map;
+    book->mapSize = fileInfo.st_size;
+    book->count = header->count;
+    book->plies = header->plies;
+    book->keys = (const uint64_t *)(header + 1);
+    book->values = (const uint16_t *)(book->keys + book->count);
+
+    return true;
+}
+
+
+/*
+ * Unmap a book. Closing a book that was never opened does nothing.
+ *
+ * params:
+ * book: the book to close
+ */
+void bookClose(Book *book)
+{
+    if (book->map != NULL)
+    {
+        munmap(book->map, book->mapSize);
+    }
+
+    memset(book, 0, sizeof(*book));
+}
+
+
+/*
+ * Look up the best move of a position in a book.
+ *
+ * params:
+ * book: the book
+ * pos: the position
+ * move: where the best move is stored if the position is found
+ * score: where the score of the best move is stored if the position is found
+ *
+ * returns:
+ * true if the position is in the book, false otherwise
+ */
+bool bookLookup(const Book *book, const Position *pos, int *move, int *score)
+{
+    uint64_t key = 0;
+    bool mirrored = false;
+    size_t low = 0;
+    size_t high = book->count;
+    size_t middle = 0;
+
+    if (pos->moves >= book->plies)
+    {
+        return false;
+    }
+
+    key = canonicalKey(pos, &mirrored);
+
+    /* Find the first key that is not less than the position key */
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (book->keys[middle] < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low == book->count || book->keys[low] != key)
+    {
+        return false;
+    }
+
+    *move = book->values[low] & ((1 << BOOK_MOVE_BITS) - 1);
+
+    if (mirrored)
+    {
+        *move = MIRROR_COLUMN(*move);
+    }
+
+    *score = (int16_t)book->values[low] >> BOOK_MOVE_BITS;
+
+    return true;
+}
+
+
+/*
+ * Build an opening book of every position with fewer than a given number of
+ * pieces, and write it to a file.
+ *
+ * The positions are collected one ply at a time: the children of the
+ * previous ply are sorted and duplicates are dropped, so a position reached
+ * through different move orders, or its mirror image, is only searched
+ * once. Positions where the game is already over are left out.
+ *
+ * Every position is searched to the same depth with no time limit, so a
+ * book takes the same time to build and holds the same scores on any
+ * machine.
+ *
+ * params:
+ * path: the book file to write
+ * plies: the book holds positions with fewer than this many pieces
+ * depth: the depth each position is searched to
+ * engine: the computer player whose table is used to score positions
+ *
+ * returns:
+ * true if the book was written, false otherwise
+ */
+bool bookBuild(const char *path, int plies, int depth, Engine *engine)
+{
+    BookHeader header = {BOOK_MAGIC, BOOK_VERSION, ROWS, COLS, 0, 0, 0};
+    SearchLimits limits = engine->limits;
+    Position *positions = NULL;     // positions of every ply, ply by ply
+    Position *grown = NULL;
+    Position child;
+    SearchResult result;
+    uint64_t key = 0;
+    bool mirrored = false;
+    uint16_t value = 0;
+    size_t plyStart = 0;            // first position of the previous ply
+    size_t plyEnd = 0;              // first position of the current ply
+    size_t count = 1;
+    size_t capacity = 1;
+    size_t unique = 0;
+    size_t i = 0;
+    int ply = 0;
+    int col = 0;
+    bool written = false;
+    FILE *file = NULL;
+
+    limits.depth = depth;
+    limits.timeLimit = 0;
+    positions = (Position *)malloc(sizeof(Position));
+
+    if (positions == NULL)
+    {
+        return false;
+    }
+
+    initPosition(&positions[0]);
+
+    for (ply = 1; ply < plies; ply++)
+    {
+        plyEnd = count;
+
+        for (i = plyStart; i < plyEnd; i++)
+        {
+            for (col = 0; col < COLS; col++)
+            {
+                if (!canPlay(&positions[i], col)
+                        || isWinningMove(&positions[i], col))
+                {
+                    continue;
+                }
+
+                if (count == capacity)
+                {
+                    capacity *= 2;
+                    grown = (Position *)realloc(positions,
+                            capacity * sizeof(Position));
+
+                    if (grown == NULL)
+                    {
+                        free(positions);
+                        return false;
+                    }
+
+                    positions = grown;
+                }
+
+                child = positions[i];
+                playMove(&child, col);
+                positions[count++] = child;
+            }
+        }
+
+        qsort(positions + plyEnd, count - plyEnd, sizeof(Position),
+                comparePositions);
+
+        unique = plyEnd;
+
+        for (i = plyEnd; i < count; i++)
+        {
+            if (i == plyEnd || comparePositions(&positions[i],
+                    &positions[unique - 1]) != 0)
+            {
+                positions[unique++] = positions[i];
+            }
+        }
+
+        plyStart = plyEnd;
+        count = unique;
+        fprintf(stderr, "Ply %d: %zu positions\n", ply, count - plyEnd);
+    }
+
+    /* Positions of different plies never share a key, so the whole list
+       can be sorted into book order at once */
+    qsort(positions, count, sizeof(Position), comparePositions);
+
+    file = fopen(path, "wb");
+
+    if (file != NULL)
+    {
+        header.plies = plies;
+        header.count = count;
+        written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+        for (i = 0; i < count && written; i++)
+        {
+            key = canonicalKey(&positions[i], NULL);
+            written = fwrite(&key, sizeof(key), 1, file) == 1;
+        }
+
+        for (i = 0; i < count && written; i++)
+        {
+            searchPosition(&positions[i], &limits, &engine->tt, &result);
+            canonicalKey(&positions[i], &mirrored);
+            value = (uint16_t)((uint16_t)result.score << BOOK_MOVE_BITS)
+                    | (mirrored ? MIRROR_COLUMN(result.bestMove)
+                        : result.bestMove);
+            written = fwrite(&value, sizeof(value), 1, file) == 1;
+
+            if ((i + 1) % 1000 == 0 || i + 1 == count)
+            {
+                fprintf(stderr, "\rScored %zu of %zu positions", i + 1, count);
+            }
+        }
+
+        fprintf(stderr, "\n");
+        written = (fclose(file) == 0) && written;
+    }
+
+    if (!written)
+    {
+        perror(path);
+    }
+
+    free(positions);
+    return written;
+}
@@ -5,12 +5,35 @@
                            rand(): to generate random numbers */
 #include <time.h>       /* time(): used to initialize the PRNG */
 #include <ctype.h>      /* isspace(): to check if a character is whitespace */
+#include <stdint.h>     /* uint64_t: storage for the bitboard masks */
+#include <limits.h>     /* UINT_MAX: to rank the moves of a position */
+#include <getopt.h>     /* getopt_long(): to parse command line options */
+#include <fcntl.h>      /* open(): to open files for mapping */
+#include <unistd.h>     /* close(): to close mapped files */
+#include <sys/mman.h>   /* mmap(): to map book files into memory */
+#include <sys/stat.h>   /* fstat(): to get the size of a mapped file */
+#include <pthread.h>    /* pthread_create(): to search with several threads */
+#include <stdatomic.h>  /* atomic_load_explicit(): to share data between
+                           threads without locks */
+#include <stdarg.h>     /* va_list: to format protocol responses */
+#include <math.h>       /* sqrtf(): to rank moves in the Monte Carlo search */
+#include <errno.h>      /* errno: to tell a full socket from a closed one */
+#include <signal.h>     /* sigaction(): to stop the server when interrupted */
+#include <sys/socket.h> /* accept(): to take the server's connections */
+#include <sys/un.h>     /* sockaddr_un: the address of the server's socket */
+#include <sys/epoll.h>  /* epoll_wait(): to wait on every client at once */
+#include <sys/eventfd.h> /* eventfd(): to wake the server after a search */
 
 
 #define BUFFER_SIZE 80  // size for input buffers, equal to width of the screen
 
+/* The board size can be chosen when building, for example -DCOLS=8 -DROWS=7 */
+#ifndef ROWS
 #define ROWS 6                  // number of rows in the game board
+#endif
+#ifndef COLS
 #define COLS 7                  // number of columns in the game board
+#endif
 #define TOP_ROW 0               // index for the top row of the game board
 #define EMPTY_CELL 0            // empty flag for a cell in the game board
 #define PLAYER_1_CELL 1         // player 1 flag for a cell in the game board
@@ -18,7 +41,428 @@
 #define COLOR_BLUE "\033[1;36m" // blue color for player 1's pieces
 #define COLOR_RED "\033[1;31m"  // red color for player 2's pieces
 #define COLOR_RESET "\033[0m"   // reset the color to normal
-#define SLEEP_TIME 1000000      // time that the computer sleeps during its turn
+#define CURSOR_HOME "\033[H"    // move the cursor to the top left corner
+#define ERASE_LINE "\033[K"     // erase the rest of the line
+#define ERASE_BELOW "\033[J"    // erase the rest of the screen
+#define THINK_TIME 1000         // time in ms the computer thinks during its turn
+#define MAX_THINK_TIME 3600000  // longest time in ms the computer may think
+
+#define BOARD_HEIGHT (ROWS + 1) // bits per bitboard column, incl. a sentinel bit
+#define CELLS (ROWS * COLS)     // number of cells in the game board
+
+#define WIN_SCORE 1000          // score of a win, less the pieces played
+#define DEFAULT_DEPTH 8         // moves looked ahead without a time limit
+#define CLOCK_CHECK_NODES 4096  // nodes searched between checks of the clock
+#define KILLER_MOVES 2          // killer moves remembered for each ply
+#define BOOK_PLIES 8            // opening book covers positions with fewer pieces
+#define BOOK_DEPTH 10           // default search depth of book positions
+#define MAX_THREADS 256         // most threads the computer may search with
+#define BENCH_DEPTH 16          // search depth of the thread benchmark
+#define MAX_GAMES 100000000     // most games a tournament may play
+#define RANDOM_PLIES 2          // random moves opening each tournament game
+#define SELFPLAY_LOG "selfplay.log" // default tournament log file
+#define SOLVE_QUEUE_SIZE 4096   // input lines the batch solver holds at once
+#define SOLVE_LINE_SIZE 128     // longest batch solver input line, plus 2
+#define DEFAULT_TT_SIZE 64      // transposition table size in megabytes
+#define MAX_TT_SIZE 65536       // largest transposition table in megabytes
+#define PROTOCOL_LINE_SIZE 256  // longest text protocol command, plus 2
+#define TABLEBASE_EMPTY 10      // empty cells of the deepest tablebase position
+#define MAX_TABLEBASE_EMPTY 100 // most empty cells a tablebase may cover
+#define MCTS_TREE_SIZE 64       // Monte Carlo tree size in megabytes
+#define MCTS_PLAYOUTS 200000    // Monte Carlo playouts without a time limit
+#define MCTS_CHECK_PLAYOUTS 256 // playouts run between checks of the clock
+#define MCTS_EXPLORATION 1.4f   // weight of the UCT bonus for rarer moves
+#define GAME_RECORDS "games.c4" // default file games are saved to
+#define RECORD_NAME_SIZE 32     // longest player name in a game record, plus 1
+#define RECORD_LINE_SIZE 512    // longest game record line, plus 2
+#define ANNOTATE_DEPTH 12       // default search depth of annotations
+#define ANNOTATE_MISTAKE 16     // score lost by a move marked as a mistake
+#define DATASET_SIZE 1000000    // default number of positions in a dataset
+#define MAX_DATASET_SIZE 1000000000 // most positions a dataset may hold
+#define DATASET_MIN_PLIES 4     // default fewest pieces of a dataset position
+#define DATASET_MAX_PLIES 24    // default most pieces of a dataset position
+#define DATASET_DEPTH 4         // default search depth of dataset labels
+#define DATASET_BATCH 1024      // positions a dataset worker writes at once
+#define SERVER_GAMES 16384      // default most games the server plays at once
+#define MAX_SERVER_GAMES 16777216 // most game slots the server may have
+#define SERVER_CLIENTS 1024     // most clients connected to the server at once
+#define SERVER_LINE_SIZE 128    // longest server command line, plus 1
+#define SERVER_ECHO_SIZE 32     // most bytes of a command word in an answer
+#define SERVER_ANSWER_SIZE (CELLS + 128) // longest server answer line
+#define SERVER_OUTPUT_SIZE 2048 // bytes of answers a client may leave unread
+#define SERVER_QUEUE_SIZE 256   // most searches queued or running at once
+#define MAX_SERVER_TIME 10000   // longest time in ms a server search may take
+#define SERVER_LATENCIES 1024   // recent search latencies kept for statistics
+#define SERVER_EVENTS 64        // most events handled per wait
+#define FRAME_SIZE ((3 * ROWS + 8) * (17 * COLS + 10) + 4 * BUFFER_SIZE)
+                                // bytes of one drawn screen, at most
+
+
+/* A set of cells packed into the bits of an integer. Cell (row, col), counted
+   from the bottom row, lives at bit col * BOARD_HEIGHT + row; the extra bit
+   on top of every column stays clear so that shifts never wrap a line of
+   pieces from one column into the next. Boards too big for 64 bits use the
+   128-bit integers of GCC and Clang. */
+#if COLS * (ROWS + 1) <= 64
+typedef uint64_t bitboard_t;
+#else
+typedef unsigned __int128 bitboard_t;
+#endif
+
+#define BITBOARD_BITS (8 * (int)sizeof(bitboard_t))
+
+/* Bottom cell of every column: all COLS * BOARD_HEIGHT low bits set, divided
+   by the bits of one column, leaves one bit per column */
+#define BOTTOM_MASK ((~(bitboard_t)0 >> (BITBOARD_BITS - COLS * BOARD_HEIGHT)) \
+        / ((((bitboard_t)1) << BOARD_HEIGHT) - 1))
+
+/* Do the positions of this board size fit in the 64 bits of a packed
+   position? */
+#define PACKED_POSITIONS (COLS * BOARD_HEIGHT <= 64)
+
+/* The column a column becomes when the board is mirrored left to right */
+#define MIRROR_COLUMN(col) (COLS - 1 - (col))
+
+/* The i-th column in order of distance from the centre, the centre first */
+#define CENTER_ORDER(i) (COLS / 2 + (1 - 2 * ((i) % 2)) * (((i) + 1) / 2))
+
+_Static_assert(COLS * BOARD_HEIGHT <= 128, "board does not fit in a bitboard");
+_Static_assert(COLS >= 1 && COLS <= 9, "moves are written as one digit 1-9");
+_Static_assert(ROWS >= 1 && CELLS <= 255, "depths are stored in 8 bits");
+
+
+/* A game position stored as one bitboard per player */
+typedef struct
+{
+    bitboard_t pieces[2];           // pieces of player 1 and player 2
+    unsigned char height[COLS];     // number of pieces in each column
+    unsigned int moves;             // number of pieces on the board
+}
+Position;
+
+
+/* Outcome and statistics of a computer player search */
+typedef struct
+{
+    int bestMove;                   // column to play, or -1 if none
+    int score;                      // score of the best move
+    int depth;                      // moves looked ahead by the deepest
+                                    // completed iteration
+    bool fromBook;                  // was the move taken from the opening book?
+    unsigned long long nodes;       // number of positions searched
+    unsigned long long playouts;    // random games of a Monte Carlo search
+    unsigned long long ttProbes;    // transposition table lookups
+    unsigned long long ttHits;      // lookups that found their position
+    unsigned long long ttCollisions; // lookups finding another position
+    unsigned long long tbHits;      // positions scored by the tablebase
+    int researches;                 // null-window searches of an exact solve
+    unsigned long long cutoffs;     // positions where a move caused a cutoff
+    unsigned long long firstCutoffs; // cutoffs by the first move tried
+    double branchingFactor;         // nodes of the last iteration over the
+                                    // nodes of the one before
+    double seconds;                 // time taken by the search
+    double iterationSeconds[CELLS]; // time of each completed iteration, by
+                                    // depth minus one
+    signed char pv[CELLS];          // principal variation: the best move and
+                                    // the expected replies
+    int pvLength;                   // number of moves in the variation
+}
+SearchResult;
+
+
+/* Result of scoring every move of a position */
+typedef struct
+{
+    SearchResult result;            // the best move, its score and the
+                                    // statistics of the whole analysis
+    int scores[COLS];               // score of each column for the player to
+                                    // move, at the depth of the result
+    bool playable[COLS];            // can each column be played?
+}
+Analysis;
+
+
+/* Kind of score stored in a transposition table entry */
+enum bound
+{
+    BOUND_NONE = 0,
+    BOUND_UPPER = 1,                // exact score is at most the stored score
+    BOUND_LOWER = 2,                // exact score is at least the stored score
+    BOUND_EXACT = 3
+};
+
+
+/* One slot of a transposition table; data packs the fields of TTData and
+   key holds the position key XORed with data */
+typedef struct
+{
+    _Atomic uint64_t key;
+    _Atomic uint64_t data;
+}
+TTEntry;
+
+
+/* Unpacked contents of a transposition table entry */
+typedef struct
+{
+    int score;
+    int depth;                      // depth the position was searched to
+    int bound;
+    int bestMove;                   // best column found, or -1 if none
+}
+TTData;
+
+
+/* Fixed-size hash table of searched positions */
+typedef struct
+{
+    TTEntry *entries;
+    size_t mask;                    // number of entries minus one
+}
+TranspositionTable;
+
+
+/* Hash table of positions solved by the weak solver; each entry is one
+   word packing the hash of the key with the outcome, bound and best move */
+typedef struct
+{
+    _Atomic uint64_t *entries;      // NULL if the table holds nothing
+    size_t mask;                    // number of entries minus one
+}
+WeakTable;
+
+
+/* Endgame tablebase file mapped into memory */
+typedef struct
+{
+    void *map;                      // the mapped file, or NULL if not open
+    size_t mapSize;
+    size_t count;                   // number of positions in the tablebase
+    unsigned int empty;             // tablebase holds positions with at most
+                                    // this many empty cells
+    const uint64_t *keys;           // position keys in ascending order
+    const int8_t *values;           // exact outcome of each key
+}
+Tablebase;
+
+
+/* How the computer player searches: how long, with how many threads, and
+   with which endgame tablebase */
+typedef struct
+{
+    int depth;                      // deepest iteration to search
+    int timeLimit;                  // time in ms to search, or 0 for no limit
+    int threads;                    // number of threads searching together
+    atomic_bool *stop;              // set to end the search early, or NULL
+    const Tablebase *tablebase;     // exact endgame scores, or NULL for none
+}
+SearchLimits;
+
+
+/* State shared by the nodes of one search */
+typedef struct
+{
+    TranspositionTable *tt;         // table of searched positions
+    SearchResult *result;           // where the statistics are counted
+    double deadline;                // clock time to stop at, or 0 for none
+    atomic_bool *stop;              // set to stop a helper thread, or NULL
+    const Tablebase *tablebase;     // exact endgame scores, or NULL for none
+    bool aborted;                   // did the search run out of time?
+    signed char killers[CELLS][KILLER_MOVES]; // recent cutoff moves by ply
+    unsigned int history[2][COLS * BOARD_HEIGHT]; // cutoffs by player, cell
+}
+SearchContext;
+
+
+/* Opening book file mapped into memory */
+typedef struct
+{
+    void *map;                      // the mapped file, or NULL if not open
+    size_t mapSize;
+    size_t count;                   // number of positions in the book
+    unsigned int plies;             // book holds positions with fewer pieces
+    const uint64_t *keys;           // position keys in ascending order
+    const uint16_t *values;         // packed move and score of each key
+}
+Book;
+
+
+/* A node of a Monte Carlo search tree: the position after a move */
+typedef struct
+{
+    uint32_t firstChild;            // index of the first child node
+    uint32_t visits;                // playouts run through the node
+    float reward;                   // playouts won, plus half those drawn, by
+                                    // the player who made the move
+    signed char move;               // column of the move, or -1 at the root
+    unsigned char children;         // number of child nodes, or 0 if none
+                                    // have been added yet
+}
+MctsNode;
+
+
+/* Nodes of the Monte Carlo search, split evenly between its workers */
+typedef struct
+{
+    MctsNode *nodes;
+    size_t nodesPerWorker;
+    int workers;                    // most workers that can search at once
+}
+MctsTree;
+
+
+/* Everything the computer player uses to choose its moves */
+typedef struct
+{
+    SearchLimits limits;
+    TranspositionTable tt;
+    Book book;
+    Tablebase tablebase;
+    MctsTree mcts;
+    bool useMcts;                   // search with Monte Carlo tree search
+                                    // instead of alpha-beta?
+    FILE *statsFile;                // where the statistics of every move are
+                                    // written, or NULL for nowhere
+    bool exact;                     // solve positions with null-window
+                                    // searches instead of searching them?
+    WeakTable weak;                 // positions solved by the weak solver
+}
+Engine;
+
+
+/* A search on the opponent's time, filling the transposition table */
+typedef struct
+{
+    pthread_t thread;
+    Position pos;                   // the position being searched
+    SearchLimits limits;
+    TranspositionTable *tt;
+    SearchResult result;
+    atomic_bool stop;               // set to end the search
+    bool running;                   // is there a thread to join?
+}
+Ponder;
+
+
+/* A game as it is saved: who played it, how it ended, and its moves */
+typedef struct
+{
+    char players[2][RECORD_NAME_SIZE]; // first and second player
+    char result[4];                 // "1-0", "0-1", "1/2" or "*"
+    char date[20];                  // when the game started, or empty
+    char moves[CELLS + 1];          // columns played from the empty board,
+                                    // starting at 1
+}
+GameRecord;
+
+
+/* Kind of player in a tournament */
+enum playerType
+{
+    PLAYER_RANDOM = 1,              // plays random moves
+    PLAYER_DEPTH = 2,               // searches to a fixed depth
+    PLAYER_TIME = 3,                // searches for a fixed time
+    PLAYER_MCTS = 4                 // runs playouts for a fixed time
+};
+
+
+/* A tournament player, as given on the command line */
+typedef struct
+{
+    int type;
+    int value;                      // depth or time in ms of the search
+}
+PlayerSpec;
+
+
+/* Settings of a headless tournament */
+typedef struct
+{
+    PlayerSpec players[2];          // player A and player B
+    int games;                      // number of games to play
+    int threads;                    // number of games played at once
+    int randomPlies;                // random moves at the start of each game
+    int ttSize;                     // table megabytes shared by all players
+    const char *logFile;            // where games are written, or NULL
+}
+Tournament;
+
+
+/* A position of a dataset file and its label. Records are 16 bytes, so the
+   packed positions stay aligned when the file is mapped. */
+typedef struct
+{
+    uint64_t position;              // the position, see packPosition()
+    int16_t score;                  // search score for the player to move
+    int8_t bestMove;                // best column found
+    uint8_t reserved[5];            // zero
+}
+DatasetRecord;
+
+
+/* Dataset file mapped into memory */
+typedef struct
+{
+    void *map;                      // the mapped file, or NULL if not open
+    size_t mapSize;
+    size_t count;                   // number of records
+    unsigned int depth;             // depth the positions were searched to
+    const DatasetRecord *records;
+}
+Dataset;
+
+
+/* Settings of a dataset to generate */
+typedef struct
+{
+    const char *path;               // where the dataset is written, or NULL
+                                    // for none
+    int count;                      // number of positions
+    int minPlies;                   // pieces on the board of each position,
+    int maxPlies;                   // chosen at random from this range
+    int depth;                      // search depth of the labels
+    int threads;                    // number of positions labelled at once
+}
+DatasetSettings;
+
+
+/* Settings taken from the command line */
+typedef struct
+{
+    int depth;                      // search depth, or 0 to use the time limit
+    int thinkTime;                  // time in ms the computer thinks per move
+    int ttSize;                     // transposition table size in megabytes
+    int threads;                    // number of threads the computer uses
+    bool benchThreads;              // compare thread counts and exit?
+    bool benchWeak;                 // compare the weak and strong solvers
+                                    // and exit?
+    const char *bookFile;           // opening book to use, or NULL for none
+    const char *buildBookFile;      // opening book to build, or NULL for none
+    int bookPlies;                  // pieces on the board when the book ends
+    int perftDepth;                 // depth to count positions to, or 0
+    const char *startMoves;         // moves played before starting, or NULL
+    Tournament tournament;          // tournament to play if games is not 0
+    const char *solveFile;          // positions to solve ("-" for stdin)
+    bool protocol;                  // read text protocol commands instead of
+                                    // playing a game?
+    const char *tablebaseFile;      // endgame tablebase to use, or NULL
+    const char *buildTablebaseFile; // tablebase to build, or NULL for none
+    int tablebaseEmpty;             // empty cells of the deepest tablebase
+                                    // position to build
+    bool mcts;                      // computer uses Monte Carlo tree search?
+    const char *statsFile;          // where move statistics are written, or
+                                    // NULL
+    bool ponder;                    // computer searches on the human's time?
+    const char *recordFile;         // where games are saved, or NULL
+    const char *annotateFile;       // games to annotate, or NULL
+    bool exact;                     // solve with null-window searches?
+    DatasetSettings dataset;        // dataset to generate
+    const char *dumpDatasetFile;    // dataset to write as text, or NULL
+    const char *serverPath;         // socket to serve games on, or NULL
+    int serverGames;                // most games the server plays at once
+    bool analyse;                   // score every column of the position?
+}
+Options;
 
 
 /* Identifier for the current player's turn */
@@ -29,26 +473,157 @@ enum player
 };
     
 
+/* How the batch solver solves a position */
+enum solveMode
+{
+    SOLVE_STRONG = 0,               // one search with the full window
+    SOLVE_EXACT = 1,                // null-window searches
+    SOLVE_WEAK = 2                  // win, draw or loss only
+};
+
+
 /* Type of the player's opponent */
 enum opponent
 {
     HUMAN = 1,
-    COMPUTER = 2
+    COMPUTER = 2,                   // alpha-beta search
+    COMPUTER_MCTS = 3               // Monte Carlo tree search
 };
 
 
-/* Function prototypes */
-bool computerMove(int board[ROWS][COLS], int currentPlayer);
-bool makeMove(int board[ROWS][COLS], int currentPlayer);
-bool placePiece(int board[ROWS][COLS], int columnChoice, int currentPlayer);
-int count(int board[ROWS][COLS], int row, int col,
-        int rowAdd, int colAdd, int cellValue);
-bool isBoardFull(int board[ROWS][COLS]);
+/* Function prototypes (ConnectFour.c) */
+bool parseOptions(int argc, char *argv[], Options *options);
+bool parseOption(const char *string, long int min, long int max,
+        const char *name, int *valuePtr);
+bool parseRange(const char *string, long int min, long int max,
+        const char *name, int *lowPtr, int *highPtr);
+void displayUsage(const char *program);
+void runPerft(Position *pos, int depth);
+bool runAnalysis(Position *pos, Engine *engine);
+bool runSolve(const char *path, Engine *engine, int threads);
+bool initEngine(Engine *engine, const Options *options);
+void freeEngine(Engine *engine);
+bool computerMove(Position *pos, Engine *engine, SearchResult *result);
+void displaySearchResult(const SearchResult *result);
+void writeSearchStats(FILE *file, const Position *pos,
+        const SearchResult *result);
+bool makeMove(Position *pos, int *colPtr);
 void switchPlayer(int *currentPlayerPtr);
-void displayBoard(int board[ROWS][COLS]);
-void printColor(char *colorString);
+void appendText(char *frame, size_t *length, const char *text);
+void displayBoard(const Position *pos, const char *heading);
 int chooseOpponent();
 bool parseInt(const char *string, long int *numberPtr);
 bool isWhitespace(const char *string);
 void clearStdinBuffer();
 void displayRules();
+
+/* Function prototypes (bitboard.c) */
+void initPosition(Position *pos);
+bool canPlay(const Position *pos, int col);
+bool isWinningMove(const Position *pos, int col);
+void playMove(Position *pos, int col);
+void undoMove(Position *pos, int col);
+bool placePiece(Position *pos, int col);
+bool isBoardFull(const Position *pos);
+bool playMoves(Position *pos, const char *moves);
+int getCell(const Position *pos, int row, int col);
+int playerToMove(const Position *pos);
+uint64_t positionKey(const Position *pos);
+uint64_t canonicalKey(const Position *pos, bool *mirrored);
+uint64_t packPosition(const Position *pos);
+bool unpackPosition(uint64_t packed, Position *pos);
+bool hasFourInARow(bitboard_t pieces);
+unsigned long long perft(Position *pos, int depth);
+
+/* Function prototypes (search.c) */
+double getTime();
+void initSearchContext(SearchContext *ctx, TranspositionTable *tt,
+        SearchResult *result);
+int orderMoves(const Position *pos, const SearchContext *ctx, int firstMove,
+        int moves[COLS]);
+void recordCutoff(const Position *pos, SearchContext *ctx, int col,
+        int depth);
+int negamax(Position *pos, int depth, int alpha, int beta, SearchContext *ctx);
+bool searchRoot(Position *pos, int depth, SearchContext *ctx);
+void searchPosition(Position *pos, const SearchLimits *limits,
+        TranspositionTable *tt, SearchResult *result);
+void analysePosition(Position *pos, const SearchLimits *limits,
+        TranspositionTable *tt, Analysis *analysis);
+void benchmarkThreads(Engine *engine);
+bool startPondering(Ponder *ponder, const Position *pos, Engine *engine);
+void stopPondering(Ponder *ponder);
+
+/* Function prototypes (transposition.c) */
+bool ttInit(TranspositionTable *tt, size_t megabytes);
+void ttFree(TranspositionTable *tt);
+void ttClear(TranspositionTable *tt);
+bool ttProbe(const TranspositionTable *tt, uint64_t key, TTData *data,
+        SearchResult *result);
+void ttStore(TranspositionTable *tt, uint64_t key, int score, int depth,
+        int bound, int bestMove);
+bool weakTableInit(WeakTable *table, size_t megabytes);
+void weakTableFree(WeakTable *table);
+void weakTableClear(WeakTable *table);
+bool weakTableProbe(const WeakTable *table, uint64_t key, int *outcome,
+        int *bound, int *bestMove, SearchResult *result);
+void weakTableStore(WeakTable *table, uint64_t key, int outcome, int bound,
+        int bestMove);
+
+/* Function prototypes (book.c) */
+bool bookOpen(Book *book, const char *path);
+void bookClose(Book *book);
+bool bookLookup(const Book *book, const Position *pos, int *move, int *score);
+bool bookBuild(const char *path, int plies, int depth, Engine *engine);
+
+/* Function prototypes (tournament.c) */
+bool parsePlayerSpec(const char *spec, PlayerSpec *player);
+bool runTournament(const Tournament *settings);
+
+/* Function prototypes (solver.c) */
+int solvedScore(int score);
+void solvePosition(Position *pos, TranspositionTable *tt, SearchResult *result);
+bool solveNullWindow(Position *pos, const SearchLimits *limits,
+        TranspositionTable *tt, SearchResult *result);
+void solveWeak(Position *pos, WeakTable *table, SearchResult *result);
+bool solveStream(FILE *input, FILE *output, TranspositionTable *tt,
+        WeakTable *weak, int threads, int mode);
+void benchmarkWeak(Engine *engine);
+
+/* Function prototypes (tablebase.c) */
+bool tablebaseOpen(Tablebase *tablebase, const char *path);
+void tablebaseClose(Tablebase *tablebase);
+bool tablebaseProbe(const Tablebase *tablebase, const Position *pos,
+        int *score);
+bool tablebaseBuild(const char *path, const Position *root, int empty);
+
+/* Function prototypes (protocol.c) */
+void runProtocol(Engine *engine, const Position *start);
+
+/* Function prototypes (record.c) */
+void recordStart(GameRecord *record, const char *first, const char *second);
+void recordMove(GameRecord *record, int col);
+void recordResult(GameRecord *record, const Position *pos, bool won);
+bool recordWrite(FILE *file, const GameRecord *record);
+bool recordSave(const char *path, const GameRecord *record);
+bool recordRead(FILE *file, GameRecord *record);
+bool annotateFile(const char *path, Engine *engine, int depth, int threads);
+
+/* Function prototypes (dataset.c) */
+bool datasetOpen(Dataset *dataset, const char *path);
+void datasetClose(Dataset *dataset);
+bool datasetGenerate(const DatasetSettings *settings, Engine *engine);
+bool datasetDump(const char *path, FILE *output);
+
+/* Function prototypes (server.c) */
+bool runServer(const char *path, Engine *engine, int gameSlots, int threads);
+
+/* Function prototypes (eval.c) */
+int initEvaluation();
+int evaluate(const Position *pos);
+
+/* Function prototypes (mcts.c) */
+bool mctsInit(MctsTree *tree, size_t megabytes, int workers);
+void mctsFree(MctsTree *tree);
+uint64_t nextRandom(uint64_t *state);
+void mctsSearch(const Position *pos, MctsTree *tree,
+        const SearchLimits *limits, SearchResult *result);
@@ -0,0 +1,395 @@
+/*
+ * Datasets of positions labelled by the engine, in a compact binary file.
+ *
+ * A position is stored packed into 64 bits (see packPosition()), which is
+ * both smaller than its moves as text and needs no parsing: a reader gets
+ * the bitboards back with a few shifts. Each position is kept in a record of
+ * fixed size with its score and best move, so the file can be mapped into
+ * memory and scanned from start to end, or the n-th record read directly:
+ *
+ * DatasetHeader | DatasetRecord records[count]
+ *
+ * Like books and tablebases, every field is stored in the byte order of the
+ * machine that wrote the file. Packed positions only fit 64 bits on boards
+ * of up to 64 bitboard bits, such as 7x6 and 8x7, so datasets cannot be made
+ * for bigger boards.
+ *
+ * The generator samples positions by playing random moves from the start up
+ * to a number of pieces drawn at random from a range, starting over if a
+ * move ends the game. Each position is then searched to a fixed depth, which
+ * gives its label. Worker threads share the engine's transposition table
+ * and take DATASET_BATCH positions at a time, which they write out in one go
+ * under a lock, so the records are in no particular order. At the default
+ * depth one core labels about 1.6 million positions a minute.
+ */
+
+
+#include "c4.h"
+
+
+#define DATASET_MAGIC "C4DS"    // identifies a dataset file
+#define DATASET_VERSION 1       // version of the dataset file layout
+
+
+/* Start of a dataset file */
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;                  // board size the dataset was made for
+    uint32_t cols;
+    uint32_t depth;                 // depth the positions were searched to
+    uint32_t reserved;
+    uint64_t count;                 // number of records
+}
+DatasetHeader;
+
+
+/* State shared by the dataset generator threads */
+typedef struct
+{
+    const DatasetSettings *settings;
+    FILE *file;
+    size_t count;                   // number of records to write
+    atomic_size_t next;             // first record of the next batch
+    SearchLimits limits;            // the label depth on one thread
+    TranspositionTable *tt;
+    uint64_t seed;                  // mixed with each batch's number
+    pthread_mutex_t lock;           // guards the file and failed
+    bool failed;                    // could a batch not be written?
+}
+DatasetWriter;
+
+
+/*
+ * Open a dataset file and map it into memory.
+ *
+ * params:
+ * dataset: the dataset to open
+ * path: the dataset file
+ *
+ * returns:
+ * true if the dataset was opened, false otherwise
+ */
+bool datasetOpen(Dataset *dataset, const char *path)
+{
+    const DatasetHeader *header = NULL;
+    struct stat fileInfo;
+    size_t expectedSize = 0;
+    void *map = MAP_FAILED;
+    int fd = -1;
+
+    memset(dataset, 0, sizeof(*dataset));
+
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    if (fstat(fd, &fileInfo) == 0
+            && (size_t)fileInfo.st_size >= sizeof(DatasetHeader))
+    {
+        map = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);                  // the mapping stays valid without the file
+
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: not a dataset\n", path);
+        return false;
+    }
+
+    header = (const DatasetHeader *)map;
+    expectedSize = sizeof(DatasetHeader)
+            + header->count * sizeof(DatasetRecord);
+
+    if (memcmp(header->magic, DATASET_MAGIC, sizeof(header->magic)) != 0
+            || header->version != DATASET_VERSION
+            || header->rows != ROWS || header->cols != COLS
+            || (size_t)fileInfo.st_size != expectedSize)
+    {
+        fprintf(stderr, "%s: not a dataset for a %dx%d board\n", path, COLS,
+                ROWS);
+        munmap(map, fileInfo.st_size);
+        return false;
+    }
+
+    /* Records are read in order, so the kernel can read ahead */
+    madvise(map, fileInfo.st_size, MADV_SEQUENTIAL);
+
+    dataset->map = map;
+    dataset->mapSize = fileInfo.st_size;
+    dataset->count = header->count;
+    dataset->depth = header->depth;
+    dataset->records = (const DatasetRecord *)(header + 1);
+
+    return true;
+}
+
+
+/*
+ * Unmap a dataset. Closing a dataset that was never opened does nothing.
+ *
+ * params:
+ * dataset: the dataset to close
+ */
+void datasetClose(Dataset *dataset)
+{
+    if (dataset->map != NULL)
+    {
+        munmap(dataset->map, dataset->mapSize);
+    }
+
+    memset(dataset, 0, sizeof(*dataset));
+}
+
+
+/*
+ * Play random moves from the start until a number of pieces is on the
+ * board.
+ *
+ * params:
+ * pos: where the position is stored
+ * plies: number of pieces to play, less than CELLS
+ * random: the generator state
+ *
+ * returns:
+ * true if the position was reached, false if a move won the game first
+ */
+static bool samplePosition(Position *pos, int plies, uint64_t *random)
+{
+    int col = 0;
+
+    initPosition(pos);
+
+    while ((int)pos->moves < plies)
+    {
+        do
+        {
+            col = (int)(((nextRandom(random) >> 32) * COLS) >> 32);
+        }
+        while (!canPlay(pos, col));
+
+        if (isWinningMove(pos, col))
+        {
+            return false;
+        }
+
+        playMove(pos, col);
+    }
+
+    return true;
+}
+
+
+/*
+ * Sample and label batches of positions, and write them to the file, until
+ * the dataset is complete.
+ *
+ * params:
+ * arg: the DatasetWriter
+ *
+ * returns:
+ * NULL
+ */
+static void *generatePositions(void *arg)
+{
+    DatasetWriter *writer = (DatasetWriter *)arg;
+    const DatasetSettings *settings = writer->settings;
+    DatasetRecord batch[DATASET_BATCH];
+    SearchResult result;
+    Position pos;
+    uint64_t random = 0;
+    size_t first = 0;
+    size_t count = 0;
+    size_t i = 0;
+    int plies = 0;
+
+    while ((first = atomic_fetch_add(&writer->next, DATASET_BATCH))
+            < writer->count)
+    {
+        count = writer->count - first < DATASET_BATCH ? writer->count - first
+                : DATASET_BATCH;
+
+        /* Every batch has its own numbers, however the batches are shared
+           out */
+        random = (writer->seed ^ (first / DATASET_BATCH + 1)
+                * 0x9e3779b97f4a7c15ULL) | 1;
+
+        for (i = 0; i < count; i++)
+        {
+            do
+            {
+                plies = settings->minPlies + (int)(((nextRandom(&random)
+                        >> 32) * (settings->maxPlies - settings->minPlies + 1))
+                        >> 32);
+            }
+            while (!samplePosition(&pos, plies, &random));
+
+            searchPosition(&pos, &writer->limits, writer->tt, &result);
+            memset(&batch[i], 0, sizeof(batch[i]));
+            batch[i].position = packPosition(&pos);
+            batch[i].score = result.score;
+            batch[i].bestMove = result.bestMove;
+        }
+
+        pthread_mutex_lock(&writer->lock);
+
+        if (fwrite(batch, sizeof(DatasetRecord), count, writer->file) != count)
+        {
+            writer->failed = true;
+        }
+
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Generate a dataset of random positions labelled by searching them, and
+ * write it to a file.
+ *
+ * params:
+ * settings: the file, number of positions, range of pieces, search depth
+ *           and threads
+ * engine: the computer player whose table and tablebase are used
+ *
+ * returns:
+ * true if the dataset was written, false otherwise
+ */
+bool datasetGenerate(const DatasetSettings *settings, Engine *engine)
+{
+    DatasetWriter writer;
+    DatasetHeader header = {DATASET_MAGIC, DATASET_VERSION, ROWS, COLS, 0, 0,
+            0};
+    pthread_t *workers = NULL;
+    double startTime = getTime();
+    double seconds = 0;
+    int started = 0;
+    int i = 0;
+    bool written = false;
+
+    if (!PACKED_POSITIONS)
+    {
+        fprintf(stderr, "Positions of a %dx%d board do not fit in 64 bits\n",
+                COLS, ROWS);
+        return false;
+    }
+
+    memset(&writer, 0, sizeof(writer));
+    writer.settings = settings;
+    writer.count = settings->count;
+    writer.limits.depth = settings->depth;
+    writer.limits.threads = 1;
+    writer.limits.tablebase = engine->limits.tablebase;
+    writer.tt = &engine->tt;
+    writer.seed = (uint64_t)(startTime * 1e9);
+    atomic_init(&writer.next, 0);
+
+    workers = (pthread_t *)calloc(settings->threads, sizeof(pthread_t));
+    writer.file = fopen(settings->path, "wb");
+
+    if (workers == NULL || writer.file == NULL)
+    {
+        perror(settings->path);
+        free(workers);
+
+        if (writer.file != NULL)
+        {
+            fclose(writer.file);
+        }
+
+        return false;
+    }
+
+    header.depth = settings->depth;
+    header.count = settings->count;
+    written = fwrite(&header, sizeof(header), 1, writer.file) == 1;
+    pthread_mutex_init(&writer.lock, NULL);
+
+    for (i = 0; written && i < settings->threads; i++)
+    {
+        if (pthread_create(&workers[started], NULL, generatePositions,
+                &writer) == 0)
+        {
+            started++;
+        }
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    seconds = getTime() - startTime;
+    written = written && started > 0 && !writer.failed;
+    written = (fclose(writer.file) == 0) && written;
+    pthread_mutex_destroy(&writer.lock);
+    free(workers);
+
+    if (!written)
+    {
+        perror(settings->path);
+        return false;
+    }
+
+    fprintf(stderr, "Wrote %zu positions in %.3f s (%.0f positions/min)\n",
+            writer.count, seconds,
+            seconds > 0 ? 60 * writer.count / seconds : 0.0);
+
+    return true;
+}
+
+
+/*
+ * Write every record of a dataset as a line of text:
+ *
+ * <packed position in hex> <pieces> <score> <best column>
+ *
+ * params:
+ * path: the dataset file
+ * output: where the lines are written
+ *
+ * returns:
+ * true if the dataset was read, false otherwise
+ */
+bool datasetDump(const char *path, FILE *output)
+{
+    Dataset dataset;
+    Position pos;
+    size_t i = 0;
+    bool valid = true;
+
+    if (!datasetOpen(&dataset, path))
+    {
+        return false;
+    }
+
+    for (i = 0; i < dataset.count && valid; i++)
+    {
+        valid = unpackPosition(dataset.records[i].position, &pos);
+
+        if (valid)
+        {
+            fprintf(output, "%016llx %u %d %d\n",
+                    (unsigned long long)dataset.records[i].position, pos.moves,
+                    dataset.records[i].score,
+                    dataset.records[i].bestMove + 1);
+        }
+    }
+
+    if (!valid)
+    {
+        fprintf(stderr, "%s: record %zu is not a valid position\n", path,
+                i - 1);
+    }
+
+    datasetClose(&dataset);
+    return valid;
+}
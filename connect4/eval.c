@@ -0,0 +1,233 @@
+/*
+ * Static evaluation of positions at the search horizon.
+ *
+ * A window is one of the lines of four cells a player could win with. A
+ * window that holds two or three pieces of one player and none of the other
+ * is still open to that player, and the more such windows a player has, the
+ * more ways they have left to win. A window with three pieces and one empty
+ * cell is a threat: the player wins by playing the empty cell. A threat
+ * matters most on a row of the right parity for its player. Play fills the
+ * board from the bottom, and when the other columns are full, the first
+ * player gets the odd rows (counted from 1 at the bottom) and the second
+ * player the even ones, so a threat on such a row usually wins in the end.
+ *
+ * The winning lines are built once into a table that holds, for each
+ * direction, the set of cells where a line of four starts. All lines of a
+ * direction are then counted together, one line per bit: the board is
+ * shifted by 0 to 3 steps along the direction, and adding up those four
+ * bitboards bit by bit gives, at the start cell of every line, the number of
+ * pieces on that line. A whole evaluation is a few dozen shifts, ANDs and
+ * bit counts, with no loop over lines or cells.
+ */
+
+
+#include "c4.h"
+
+
+#define DIRECTIONS 4            // vertical, horizontal and both diagonals
+#define TWO_WEIGHT 1            // score of an open window with two pieces
+#define THREE_WEIGHT 4          // score of an open window with three pieces
+#define THREAT_WEIGHT 8         // extra score of a threat on a row of the
+                                // threat player's parity
+#define EVAL_LIMIT (WIN_SCORE / 2) // largest score, well below any win
+
+
+/* Steps between the bits of neighbouring cells in each direction */
+static const int steps[DIRECTIONS] =
+{
+    1,                  // vertical
+    BOARD_HEIGHT,       // horizontal
+    BOARD_HEIGHT - 1,   // diagonal going down to the right
+    BOARD_HEIGHT + 1    // diagonal going up to the right
+};
+
+/* Start cells of the winning lines of each direction, set by initEvaluation */
+static bitboard_t lineStarts[DIRECTIONS];
+
+/* Rows of the parity each player's threats are strongest on */
+static bitboard_t threatRows[2];
+
+
+/*
+ * Count the set bits of a bitboard.
+ *
+ * params:
+ * bits: the bitboard
+ *
+ * returns:
+ * the number of bits set
+ */
+static inline int countBits(bitboard_t bits)
+{
+#if COLS * (ROWS + 1) > 64
+    return __builtin_popcountll((uint64_t)bits)
+            + __builtin_popcountll((uint64_t)(bits >> 64));
+#else
+    return __builtin_popcountll(bits);
+#endif
+}
+
+
+/*
+ * Build the table of winning lines and the threat rows of each player. This
+ * must be called once before evaluate().
+ *
+ * returns:
+ * the number of winning lines on the board (69 on a 7x6 board)
+ */
+int initEvaluation()
+{
+    static const int rowSteps[DIRECTIONS] = {1, 0, -1, 1};
+    static const int colSteps[DIRECTIONS] = {0, 1, 1, 1};
+    int lines = 0;
+    int direction = 0;
+    int row = 0;
+    int col = 0;
+    int endRow = 0;
+    int endCol = 0;
+
+    for (direction = 0; direction < DIRECTIONS; direction++)
+    {
+        lineStarts[direction] = 0;
+
+        for (col = 0; col < COLS; col++)
+        {
+            for (row = 0; row < ROWS; row++)
+            {
+                endRow = row + 3 * rowSteps[direction];
+                endCol = col + 3 * colSteps[direction];
+
+                if (endRow >= 0 && endRow < ROWS && endCol < COLS)
+                {
+                    lineStarts[direction] |= (bitboard_t)1
+                            << (col * BOARD_HEIGHT + row);
+                    lines++;
+                }
+            }
+        }
+    }
+
+    threatRows[0] = 0;
+    threatRows[1] = 0;
+
+    for (row = 0; row < ROWS; row++)
+    {
+        threatRows[row % 2] |= BOTTOM_MASK << row;
+    }
+
+    return lines;
+}
+
+
+/*
+ * Count the open windows of one player along one direction with two and with
+ * three pieces, and find the empty cells that would complete a window of
+ * three.
+ *
+ * params:
+ * pieces: the pieces of the player
+ * others: the pieces of the other player
+ * direction: the direction of the lines
+ * twos: the number of open windows with two pieces is added to this
+ * threes: the number of open windows with three pieces is added to this
+ *
+ * returns:
+ * the cells where the player would make four in a row along the direction
+ */
+static inline bitboard_t countLines(bitboard_t pieces, bitboard_t others,
+        int direction, int *twos, int *threes)
+{
+    int step = steps[direction];
+    bitboard_t p0 = pieces;
+    bitboard_t p1 = pieces >> step;
+    bitboard_t p2 = pieces >> (2 * step);
+    bitboard_t p3 = pieces >> (3 * step);
+    bitboard_t open = lineStarts[direction] & ~(others | others >> step
+            | others >> (2 * step) | others >> (3 * step));
+    bitboard_t low = 0;
+    bitboard_t high = 0;
+    bitboard_t three = 0;
+
+    /* Add the four cells of every line bit by bit: low and high are the 1
+       and 2 bits of the count, which is never 4 as the game would be over */
+    low = p0 ^ p1 ^ p2 ^ p3;
+    high = ((p0 & p1) ^ (p2 & p3)) ^ ((p0 ^ p1) & (p2 ^ p3));
+    three = open & high & low;
+
+    *twos += countBits(open & high & ~low);
+    *threes += countBits(three);
+
+    return (three | three << step | three << (2 * step) | three << (3 * step))
+            & ~(pieces | others);
+}
+
+
+/*
+ * Count the open windows of one player with two and with three pieces, and
+ * find the empty cells that would complete a window of three. The
+ * directions are written out so that every shift is by a constant.
+ *
+ * params:
+ * pieces: the pieces of the player
+ * others: the pieces of the other player
+ * twos: where the number of open windows with two pieces is stored
+ * threes: where the number of open windows with three pieces is stored
+ *
+ * returns:
+ * the cells where the player would make four in a row
+ */
+static inline bitboard_t countWindows(bitboard_t pieces, bitboard_t others,
+        int *twos, int *threes)
+{
+    *twos = 0;
+    *threes = 0;
+
+    return countLines(pieces, others, 0, twos, threes)
+            | countLines(pieces, others, 1, twos, threes)
+            | countLines(pieces, others, 2, twos, threes)
+            | countLines(pieces, others, 3, twos, threes);
+}
+
+
+/*
+ * Score a position without searching it, from the point of view of the
+ * player to move. The score counts the open windows of two and three pieces
+ * and the threats on rows of the right parity, the opponent's counting
+ * against the player, and always stays within EVAL_LIMIT of 0.
+ *
+ * params:
+ * pos: the position
+ *
+ * returns:
+ * the score of the position
+ */
+int evaluate(const Position *pos)
+{
+    int player = pos->moves & 1;
+    bitboard_t own = pos->pieces[player];
+    bitboard_t other = pos->pieces[player ^ 1];
+    bitboard_t ownThreats = 0;
+    bitboard_t otherThreats = 0;
+    int ownTwos = 0, ownThrees = 0;
+    int otherTwos = 0, otherThrees = 0;
+    int score = 0;
+
+    ownThreats = countWindows(own, other, &ownTwos, &ownThrees);
+    otherThreats = countWindows(other, own, &otherTwos, &otherThrees);
+
+    score = TWO_WEIGHT * (ownTwos - otherTwos)
+            + THREE_WEIGHT * (ownThrees - otherThrees)
+            + THREAT_WEIGHT * (countBits(ownThreats & threatRows[player])
+                - countBits(otherThreats & threatRows[player ^ 1]));
+
+    if (score > EVAL_LIMIT)
+    {
+        score = EVAL_LIMIT;
+    }
+    else if (score < -EVAL_LIMIT)
+    {
+        score = -EVAL_LIMIT;
+    }
+
+    return score;
+}
@@ -0,0 +1,493 @@
+/*
+ * Monte Carlo tree search player, an alternative to the alpha-beta search.
+ *
+ * Instead of scoring positions, the player plays many random games, called
+ * playouts, from the position and grows a tree of the moves that did best
+ * in them. Each playout walks down the tree choosing moves with UCT: the
+ * child with the highest share of playouts won, plus a bonus for children
+ * tried less often than their siblings, so that no move is given up on too
+ * early. At a leaf that has been reached before, all its moves are added to
+ * the tree, and the rest of the game is played at random. The result is then
+ * counted in every node on the way down. The move played is the one whose
+ * subtree ran the most playouts.
+ *
+ * Nodes are never allocated one at a time. The tree owns one block of nodes
+ * sized when the program starts, and a search hands them out in order; the
+ * children of a node sit next to each other, so a node only needs the index
+ * of its first child. When the block is full the tree stops growing and the
+ * search goes on with playouts from its leaves.
+ *
+ * Playouts draw their moves from an xorshift generator, which is much faster
+ * than rand() and keeps no shared state between threads. With more than one
+ * thread the search runs root-parallel: every worker grows its own tree, in
+ * its own share of the nodes, from its own random numbers, and the playouts
+ * of the root moves of all the trees are added up at the end. The workers
+ * share nothing while they run, so playouts per second grow with the cores.
+ */
+
+
+#include "c4.h"
+
+
+/* A worker of the search, growing its own tree */
+typedef struct
+{
+    pthread_t thread;
+    MctsNode *nodes;                // the worker's share of the nodes
+    uint32_t capacity;              // number of nodes in the share
+    uint32_t used;                  // number of nodes in the tree
+    Position root;
+    uint64_t random;                // xorshift state, never 0
+    double deadline;                // clock time to stop at, or 0 for none
+    unsigned long long maxPlayouts; // playouts to run if there is no deadline
+    atomic_bool *stop;              // set to end the search early, or NULL
+    unsigned long long playouts;    // playouts run
+    int depth;                      // deepest node reached below the root
+}
+MctsWorker;
+
+
+/*
+ * Allocate the nodes of the tree, shared evenly between the workers.
+ *
+ * params:
+ * tree: the tree to initialize
+ * megabytes: size of the nodes in megabytes
+ * workers: most workers that will search with the tree
+ *
+ * returns:
+ * true if the nodes were allocated, false otherwise
+ */
+bool mctsInit(MctsTree *tree, size_t megabytes, int workers)
+{
+    size_t perWorker = megabytes * 1024 * 1024 / sizeof(MctsNode) / workers;
+
+    tree->nodes = NULL;
+    tree->nodesPerWorker = 0;
+    tree->workers = 0;
+
+    /* Room for the root and its children at least, and no more than the
+       32-bit child indexes can reach */
+    if (perWorker < COLS + 1)
+    {
+        perWorker = COLS + 1;
+    }
+    else if (perWorker > UINT32_MAX)
+    {
+        perWorker = UINT32_MAX;
+    }
+
+    /* Not cleared: nodes are set up as they are handed out, and pages that
+       are never used are never touched */
+    tree->nodes = (MctsNode *)malloc(perWorker * workers * sizeof(MctsNode));
+
+    if (tree->nodes != NULL)
+    {
+        tree->nodesPerWorker = perWorker;
+        tree->workers = workers;
+    }
+
+    return tree->nodes != NULL;
+}
+
+
+/*
+ * Free the nodes of a tree.
+ *
+ * params:
+ * tree: the tree to free
+ */
+void mctsFree(MctsTree *tree)
+{
+    free(tree->nodes);
+    tree->nodes = NULL;
+    tree->nodesPerWorker = 0;
+    tree->workers = 0;
+}
+
+
+/*
+ * Draw the next number of an xorshift generator. Other modules that need
+ * fast random numbers with no shared state use it too.
+ *
+ * params:
+ * state: the generator state, which must not be 0
+ *
+ * returns:
+ * a random 64-bit number
+ */
+uint64_t nextRandom(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+
+/*
+ * Play random moves until the game ends.
+ *
+ * params:
+ * pos: the position to play from, which is changed
+ * random: the generator state
+ *
+ * returns:
+ * the player who won (0 for the first player, 1 for the second), or -1 for
+ * a draw
+ */
+static int playout(Position *pos, uint64_t *random)
+{
+    int col = 0;
+    int player = 0;
+
+    while (!isBoardFull(pos))
+    {
+        do
+        {
+            /* The high 32 bits times COLS, over 2^32, is a column in range
+               without a division */
+            col = (int)(((nextRandom(random) >> 32) * COLS) >> 32);
+        }
+        while (!canPlay(pos, col));
+
+        player = pos->moves & 1;
+
+        if (placePiece(pos, col))
+        {
+            return player;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+ * Add the moves of a leaf to the tree, in order from the centre out.
+ *
+ * params:
+ * worker: the worker growing the tree
+ * node: index of the leaf
+ * pos: the position of the leaf, which must not be full or won
+ *
+ * returns:
+ * true if the moves were added, false if the tree is full
+ */
+static bool expandNode(MctsWorker *worker, uint32_t node, const Position *pos)
+{
+    MctsNode *child = NULL;
+    int count = 0;
+    int i = 0;
+
+    for (i = 0; i < COLS; i++)
+    {
+        count += canPlay(pos, i);
+    }
+
+    if (worker->capacity - worker->used < (uint32_t)count)
+    {
+        return false;
+    }
+
+    worker->nodes[node].firstChild = worker->used;
+    worker->nodes[node].children = count;
+    child = &worker->nodes[worker->used];
+    worker->used += count;
+
+    for (i = 0; i < COLS; i++)
+    {
+        if (canPlay(pos, CENTER_ORDER(i)))
+        {
+            child->firstChild = 0;
+            child->visits = 0;
+            child->reward = 0;
+            child->move = CENTER_ORDER(i);
+            child->children = 0;
+            child++;
+        }
+    }
+
+    return true;
+}
+
+
+/*
+ * Choose the child of a node to walk down to with UCT. Children that have
+ * never been tried come first, the centre first.
+ *
+ * params:
+ * worker: the worker growing the tree
+ * node: index of the node, which must have children
+ *
+ * returns:
+ * index of the child
+ */
+static uint32_t selectChild(const MctsWorker *worker, uint32_t node)
+{
+    const MctsNode *parent = &worker->nodes[node];
+    const MctsNode *child = NULL;
+    float logVisits = logf((float)parent->visits);
+    float value = 0;
+    float bestValue = -1;
+    uint32_t best = parent->firstChild;
+    uint32_t i = 0;
+
+    for (i = parent->firstChild; i < parent->firstChild + parent->children;
+            i++)
+    {
+        child = &worker->nodes[i];
+
+        if (child->visits == 0)
+        {
+            return i;
+        }
+
+        value = child->reward / child->visits
+                + MCTS_EXPLORATION * sqrtf(logVisits / child->visits);
+
+        if (value > bestValue)
+        {
+            bestValue = value;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+
+/*
+ * Run one playout: walk down the tree, grow it by one leaf's moves, play
+ * the rest of the game at random, and count the result on the way back.
+ *
+ * params:
+ * worker: the worker growing the tree
+ */
+static void runPlayout(MctsWorker *worker)
+{
+    uint32_t path[CELLS + 1];       // nodes walked through, the root first
+    Position pos = worker->root;
+    MctsNode *node = NULL;
+    int length = 1;
+    int winner = -1;
+    int player = 0;
+    bool over = false;
+    int i = 0;
+
+    path[0] = 0;
+
+    while (!over)
+    {
+        node = &worker->nodes[path[length - 1]];
+
+        if (isBoardFull(&pos))
+        {
+            over = true;            // a draw
+            break;
+        }
+
+        /* A leaf grows once it has been reached a second time, so single
+           playouts down poor lines do not fill the tree */
+        if (node->children == 0 && ((node->visits == 0 && length > 1)
+                || !expandNode(worker, path[length - 1], &pos)))
+        {
+            break;
+        }
+
+        path[length] = selectChild(worker, path[length - 1]);
+        player = pos.moves & 1;
+
+        if (placePiece(&pos, worker->nodes[path[length]].move))
+        {
+            winner = player;
+            over = true;
+        }
+
+        length++;
+    }
+
+    if (!over)
+    {
+        winner = playout(&pos, &worker->random);
+    }
+
+    if (length - 1 > worker->depth)
+    {
+        worker->depth = length - 1;
+    }
+
+    /* A node's reward counts for the player who moved into it */
+    for (i = 0; i < length; i++)
+    {
+        node = &worker->nodes[path[i]];
+        node->visits++;
+
+        if (winner < 0)
+        {
+            node->reward += 0.5f;
+        }
+        else if (winner == (int)((worker->root.moves + i - 1) & 1))
+        {
+            node->reward += 1;
+        }
+    }
+}
+
+
+/*
+ * Run playouts until the deadline, the stop flag or the playout limit.
+ *
+ * params:
+ * arg: the MctsWorker
+ *
+ * returns:
+ * NULL
+ */
+static void *searchWorker(void *arg)
+{
+    MctsWorker *worker = (MctsWorker *)arg;
+
+    worker->nodes[0].firstChild = 0;
+    worker->nodes[0].visits = 0;
+    worker->nodes[0].reward = 0;
+    worker->nodes[0].move = -1;
+    worker->nodes[0].children = 0;
+    worker->used = 1;
+
+    while (true)
+    {
+        runPlayout(worker);
+        worker->playouts++;
+
+        if (worker->deadline == 0 && worker->playouts >= worker->maxPlayouts)
+        {
+            break;
+        }
+
+        if (worker->playouts % MCTS_CHECK_PLAYOUTS == 0
+                && ((worker->deadline > 0 && getTime() >= worker->deadline)
+                    || (worker->stop != NULL && atomic_load(worker->stop))))
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Find the best move for the player to move with Monte Carlo tree search.
+ * The board must not be full.
+ *
+ * The search runs for the time limit, or MCTS_PLAYOUTS playouts if there is
+ * none, on as many workers as the limits ask for and the tree was made for;
+ * the depth limit does not apply. Setting the stop flag of the limits ends
+ * the search early. The score of the result is the share of playouts the
+ * best move won, from 0 to 1000, and its node count is the size of the
+ * trees.
+ *
+ * params:
+ * pos: the position to search
+ * tree: the nodes to grow the trees in
+ * limits: the time limit, threads and stop flag
+ * result: where the best move and the search statistics are stored
+ */
+void mctsSearch(const Position *pos, MctsTree *tree,
+        const SearchLimits *limits, SearchResult *result)
+{
+    MctsWorker workers[MAX_THREADS];
+    unsigned long long visits[COLS] = {0};
+    double reward[COLS] = {0};
+    double startTime = getTime();
+    const MctsNode *child = NULL;
+    uint64_t seed = (uint64_t)(startTime * 1e9);
+    int count = limits->threads < tree->workers ? limits->threads
+            : tree->workers;
+    int started = 0;
+    int i = 0;
+    uint32_t c = 0;
+
+    memset(result, 0, sizeof(*result));
+    result->bestMove = -1;
+
+    if (count < 1)
+    {
+        count = 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        memset(&workers[i], 0, sizeof(workers[i]));
+        workers[i].nodes = tree->nodes + i * tree->nodesPerWorker;
+        workers[i].capacity = tree->nodesPerWorker;
+        workers[i].root = *pos;
+        workers[i].random = (seed ^ (i + 1) * 0x9e3779b97f4a7c15ULL) | 1;
+        workers[i].maxPlayouts = (MCTS_PLAYOUTS + count - 1) / count;
+        workers[i].stop = limits->stop;
+
+        if (limits->timeLimit > 0)
+        {
+            workers[i].deadline = startTime + limits->timeLimit / 1000.0;
+        }
+    }
+
+    /* The calling thread is the first worker */
+    for (i = 1; i < count; i++)
+    {
+        if (pthread_create(&workers[i].thread, NULL, searchWorker,
+                &workers[i]) != 0)
+        {
+            break;
+        }
+
+        started++;
+    }
+
+    searchWorker(&workers[0]);
+
+    for (i = 1; i <= started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    for (i = 0; i <= started; i++)
+    {
+        for (c = 0; c < workers[i].nodes[0].children; c++)
+        {
+            child = &workers[i].nodes[workers[i].nodes[0].firstChild + c];
+            visits[(int)child->move] += child->visits;
+            reward[(int)child->move] += child->reward;
+        }
+
+        result->playouts += workers[i].playouts;
+        result->nodes += workers[i].used;
+
+        if (workers[i].depth > result->depth)
+        {
+            result->depth = workers[i].depth;
+        }
+    }
+
+    for (i = 0; i < COLS; i++)
+    {
+        if (visits[i] > 0 && (result->bestMove < 0
+                || visits[i] > visits[result->bestMove]))
+        {
+            result->bestMove = i;
+        }
+    }
+
+    if (result->bestMove >= 0)
+    {
+        result->score = (int)(1000 * reward[result->bestMove]
+                / visits[result->bestMove] + 0.5);
+    }
+
+    result->seconds = getTime() - startTime;
+}
@@ -0,0 +1,328 @@
+/*
+ * Line-based text protocol for driving the engine from other programs.
+ *
+ * Commands are read one per line from the standard input, and every
+ * response is one line on the standard output. Nothing else is written
+ * there: no prompts, board drawings or colours. Columns count from 1.
+ *
+ * position [moves]     set the position: the empty board, then the moves
+ * go [depth N] [time MS] [infinite]
+ *                      search the position in the background, with the
+ *                      engine's limits unless given; "infinite" searches
+ *                      until stopped. Answers, once the search ends:
+ *                      bestmove <col> score <score> depth <depth>
+ *                      nodes <nodes> time <ms>
+ *                      or "bestmove <col> score <score> book" for a book
+ *                      move, or "bestmove none" if the board is full
+ * stop                 end the search, which then gives its best move
+ * eval                 answers "eval <score>", the static evaluation of the
+ *                      position for the player to move
+ * isready              answers "readyok"
+ * quit                 stop any search and leave
+ *
+ * Commands that cannot be carried out answer "error <reason>". The search
+ * runs on its own thread, so commands are still read while it runs, and
+ * "stop" takes effect within a few nodes.
+ */
+
+
+#include "c4.h"
+
+
+/* State of the protocol, shared with the search thread */
+typedef struct
+{
+    Engine *engine;
+    Position pos;                   // position of the last position command
+    Position searchPos;             // copy of the position being searched
+    SearchLimits limits;            // limits of the running search
+    atomic_bool stop;               // set to end the running search
+    atomic_bool finished;           // set by the search thread as it ends
+    bool searching;                 // is there a search thread to join?
+    pthread_t thread;
+    pthread_mutex_t outputLock;     // keeps response lines whole
+}
+ProtocolState;
+
+
+/*
+ * Write one response line and flush it, so the program on the other end
+ * sees it at once.
+ *
+ * params:
+ * state: the protocol state
+ * format: printf() format of the line, without the line ending
+ * ...: the values of the format
+ */
+static void respond(ProtocolState *state, const char *format, ...)
+{
+    va_list args;
+
+    pthread_mutex_lock(&state->outputLock);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+    fflush(stdout);
+    pthread_mutex_unlock(&state->outputLock);
+}
+
+
+/*
+ * Search the position of the state and answer with the best move.
+ *
+ * params:
+ * arg: the ProtocolState
+ *
+ * returns:
+ * NULL
+ */
+static void *searchThread(void *arg)
+{
+    ProtocolState *state = (ProtocolState *)arg;
+    SearchResult result;
+
+    searchPosition(&state->searchPos, &state->limits, &state->engine->tt,
+            &result);
+
+    if (state->engine->statsFile != NULL)
+    {
+        writeSearchStats(state->engine->statsFile, &state->searchPos,
+                &result);
+    }
+
+    /* Finish first, so a command sent in reply to the best move never
+       finds the search still running */
+    atomic_store(&state->finished, true);
+    respond(state, "bestmove %d score %d depth %d nodes %llu time %.0f",
+            result.bestMove + 1, result.score, result.depth, result.nodes,
+            result.seconds * 1000);
+
+    return NULL;
+}
+
+
+/*
+ * Determine if a search is running, and clean up after one that has ended.
+ *
+ * params:
+ * state: the protocol state
+ *
+ * returns:
+ * true if a search is still running, false otherwise
+ */
+static bool isSearching(ProtocolState *state)
+{
+    if (state->searching && atomic_load(&state->finished))
+    {
+        pthread_join(state->thread, NULL);
+        state->searching = false;
+    }
+
+    return state->searching;
+}
+
+
+/*
+ * End the running search, if any, and wait for it to give its best move.
+ *
+ * params:
+ * state: the protocol state
+ */
+static void stopSearch(ProtocolState *state)
+{
+    if (state->searching)
+    {
+        atomic_store(&state->stop, true);
+        pthread_join(state->thread, NULL);
+        state->searching = false;
+    }
+}
+
+
+/*
+ * Carry out a position command.
+ *
+ * params:
+ * state: the protocol state
+ * moves: the moves from the empty board, or NULL for none
+ */
+static void setPosition(ProtocolState *state, const char *moves)
+{
+    Position pos;
+
+    initPosition(&pos);
+
+    if (isSearching(state))
+    {
+        respond(state, "error search in progress");
+    }
+    else if (moves != NULL && !playMoves(&pos, moves))
+    {
+        respond(state, "error invalid moves %s", moves);
+    }
+    else
+    {
+        state->pos = pos;
+    }
+}
+
+
+/*
+ * Carry out a go command: answer from the book, or start a search.
+ *
+ * params:
+ * state: the protocol state
+ * args: the rest of the command line, split by strtok_r()
+ */
+static void startSearch(ProtocolState *state, char *args)
+{
+    SearchLimits limits = state->engine->limits;
+    char *word = NULL;
+    char *value = NULL;
+    long int number = 0;
+    int move = 0;
+    int score = 0;
+
+    for (word = strtok_r(NULL, " \t", &args); word != NULL;
+            word = strtok_r(NULL, " \t", &args))
+    {
+        if (strcmp(word, "infinite") == 0)
+        {
+            limits.depth = 0;
+            limits.timeLimit = 0;
+            continue;
+        }
+
+        value = strtok_r(NULL, " \t", &args);
+
+        if (value == NULL || !parseInt(value, &number) || number < 1
+                || (strcmp(word, "depth") == 0 && number > CELLS)
+                || (strcmp(word, "time") == 0 && number > MAX_THINK_TIME))
+        {
+            respond(state, "error invalid %s", word);
+            return;
+        }
+
+        if (strcmp(word, "depth") == 0)
+        {
+            limits.depth = number;
+            limits.timeLimit = 0;
+        }
+        else if (strcmp(word, "time") == 0)
+        {
+            limits.timeLimit = number;
+            limits.depth = 0;
+        }
+        else
+        {
+            respond(state, "error unknown go option %s", word);
+            return;
+        }
+    }
+
+    if (isSearching(state))
+    {
+        respond(state, "error search in progress");
+    }
+    else if (isBoardFull(&state->pos))
+    {
+        respond(state, "bestmove none");
+    }
+    else if (bookLookup(&state->engine->book, &state->pos, &move, &score))
+    {
+        respond(state, "bestmove %d score %d book", move + 1, score);
+    }
+    else
+    {
+        state->searchPos = state->pos;
+        state->limits = limits;
+        state->limits.stop = &state->stop;
+        atomic_store(&state->stop, false);
+        atomic_store(&state->finished, false);
+
+        if (pthread_create(&state->thread, NULL, searchThread, state) == 0)
+        {
+            state->searching = true;
+        }
+        else
+        {
+            respond(state, "error could not start the search");
+        }
+    }
+}
+
+
+/*
+ * Read and carry out protocol commands until "quit" or the end of the
+ * input.
+ *
+ * params:
+ * engine: the computer player whose limits, table and book are used
+ * start: the position before the first position command
+ */
+void runProtocol(Engine *engine, const Position *start)
+{
+    ProtocolState state;
+    char line[PROTOCOL_LINE_SIZE];
+    char *command = NULL;
+    char *rest = NULL;
+    bool quit = false;
+
+    memset(&state, 0, sizeof(state));
+    state.engine = engine;
+    state.pos = *start;
+    atomic_init(&state.stop, false);
+    atomic_init(&state.finished, false);
+    pthread_mutex_init(&state.outputLock, NULL);
+
+    while (!quit && fgets(line, sizeof(line), stdin) != NULL)
+    {
+        if (strchr(line, '\n') == NULL && !feof(stdin))
+        {
+            clearStdinBuffer();
+            respond(&state, "error line too long");
+            continue;
+        }
+
+        line[strcspn(line, "\r\n")] = '\0';
+        command = strtok_r(line, " \t", &rest);
+
+        if (command == NULL)
+        {
+            continue;               // blank line
+        }
+
+        if (strcmp(command, "position") == 0)
+        {
+            setPosition(&state, strtok_r(NULL, " \t", &rest));
+        }
+        else if (strcmp(command, "go") == 0)
+        {
+            startSearch(&state, rest);
+        }
+        else if (strcmp(command, "stop") == 0)
+        {
+            stopSearch(&state);
+        }
+        else if (strcmp(command, "eval") == 0)
+        {
+            respond(&state, "eval %d", evaluate(&state.pos));
+        }
+        else if (strcmp(command, "isready") == 0)
+        {
+            respond(&state, "readyok");
+        }
+        else if (strcmp(command, "quit") == 0)
+        {
+            quit = true;
+        }
+        else
+        {
+            respond(&state, "error unknown command %s", command);
+        }
+    }
+
+    stopSearch(&state);
+    pthread_mutex_destroy(&state.outputLock);
+}
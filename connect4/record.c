@@ -0,0 +1,522 @@
+/*
+ * Game records, and the batch annotation of recorded games.
+ *
+ * A record file holds any number of games, two lines each: a header, then
+ * the moves of the game as column numbers starting at 1, from the empty
+ * board:
+ *
+ * #c4 <cols>x<rows> <result> <first player> <second player> <date>
+ * <moves>
+ *
+ * The result is 1-0 or 0-1 for a win by the first or the second player,
+ * 1/2 for a draw, or * for a game that did not finish. Player names and the
+ * date (in ISO 8601, local time) hold no spaces. Games are added to the end
+ * of a file, so one file can collect every game ever played.
+ *
+ * Annotating scores every move of every game of a file: for each position,
+ * the best move and its score, and the score of the move played, each found
+ * with a search to a fixed depth. A move that throws away a forced win, or
+ * walks into a forced loss the best move avoids, is a blunder, marked "??";
+ * when no forced result is in sight, a move scored ANNOTATE_MISTAKE or more
+ * below the best is a mistake, marked "?". Games are shared out between
+ * worker threads, one game at a time, and all the workers share the
+ * engine's transposition table, so positions that recur between games, like
+ * most openings, are only searched once.
+ */
+
+
+#include "c4.h"
+
+
+/* Scores of a move of an annotated game, for the player who made it */
+typedef struct
+{
+    int score;                      // score of the move played
+    int bestScore;                  // score of the best move
+    int bestMove;                   // the best move
+}
+MoveNote;
+
+
+/* State shared by the annotation workers */
+typedef struct
+{
+    GameRecord *records;
+    MoveNote (*notes)[CELLS];       // the notes of every move of every game
+    size_t count;                   // number of games
+    atomic_size_t next;             // next game to annotate
+    TranspositionTable *tt;
+    SearchLimits limits;            // a fixed depth on one thread, for the
+                                    // positions of the games
+    SearchLimits replyLimits;       // one move less deep, for the positions
+                                    // after the moves played
+    atomic_ullong nodes;            // nodes searched by all the workers
+}
+Annotator;
+
+
+/*
+ * Start the record of a new game, dated now.
+ *
+ * params:
+ * record: the record to start
+ * first: name of the player who moves first
+ * second: name of the other player
+ */
+void recordStart(GameRecord *record, const char *first, const char *second)
+{
+    time_t now = time(NULL);
+    struct tm local;
+
+    memset(record, 0, sizeof(*record));
+    snprintf(record->players[0], RECORD_NAME_SIZE, "%s", first);
+    snprintf(record->players[1], RECORD_NAME_SIZE, "%s", second);
+    strcpy(record->result, "*");
+
+    if (localtime_r(&now, &local) != NULL)
+    {
+        strftime(record->date, sizeof(record->date), "%Y-%m-%dT%H:%M:%S",
+                &local);
+    }
+}
+
+
+/*
+ * Add a move to a game record.
+ *
+ * params:
+ * record: the record
+ * col: the column played
+ */
+void recordMove(GameRecord *record, int col)
+{
+    size_t length = strlen(record->moves);
+
+    if (length < CELLS)
+    {
+        record->moves[length] = '1' + col;
+        record->moves[length + 1] = '\0';
+    }
+}
+
+
+/*
+ * Set the result of a finished game.
+ *
+ * params:
+ * record: the record
+ * pos: the final position
+ * won: did the last move win the game?
+ */
+void recordResult(GameRecord *record, const Position *pos, bool won)
+{
+    if (!won)
+    {
+        strcpy(record->result, "1/2");
+    }
+    else
+    {
+        /* The winner made the last move */
+        strcpy(record->result, (pos->moves & 1) ? "1-0" : "0-1");
+    }
+}
+
+
+/*
+ * Write the header line of a game record.
+ *
+ * params:
+ * file: where the header is written
+ * record: the record
+ *
+ * returns:
+ * true if the header was written, false otherwise
+ */
+static bool writeHeader(FILE *file, const GameRecord *record)
+{
+    return fprintf(file, "#c4 %dx%d %s %s %s %s\n", COLS, ROWS,
+            record->result, record->players[0], record->players[1],
+            record->date[0] != '\0' ? record->date : "-") > 0;
+}
+
+
+/*
+ * Write a game record.
+ *
+ * params:
+ * file: where the record is written
+ * record: the record
+ *
+ * returns:
+ * true if the record was written, false otherwise
+ */
+bool recordWrite(FILE *file, const GameRecord *record)
+{
+    return writeHeader(file, record)
+            && fprintf(file, "%s\n", record->moves) > 0;
+}
+
+
+/*
+ * Add a game record to the end of a file.
+ *
+ * params:
+ * path: the record file, which is created if it does not exist
+ * record: the record
+ *
+ * returns:
+ * true if the record was saved, false otherwise
+ */
+bool recordSave(const char *path, const GameRecord *record)
+{
+    FILE *file = fopen(path, "a");
+    bool saved = false;
+
+    if (file != NULL)
+    {
+        saved = recordWrite(file, record);
+        saved = (fclose(file) == 0) && saved;
+    }
+
+    if (!saved)
+    {
+        perror(path);
+    }
+
+    return saved;
+}
+
+
+/*
+ * Read the next game record of a file. Records for another board size,
+ * and lines that are not records, are skipped with a warning.
+ *
+ * params:
+ * file: the record file
+ * record: where the record is stored
+ *
+ * returns:
+ * true if a record was read, false at the end of the file
+ */
+bool recordRead(FILE *file, GameRecord *record)
+{
+    char line[RECORD_LINE_SIZE];
+    char moves[RECORD_LINE_SIZE];
+    char size[RECORD_NAME_SIZE];
+    char format[BUFFER_SIZE];
+    Position pos;
+    bool over = false;
+    int fields = 0;
+    size_t i = 0;
+
+    snprintf(format, sizeof(format), "#c4 %%%ds %%3s %%%ds %%%ds %%19s",
+            RECORD_NAME_SIZE - 1, RECORD_NAME_SIZE - 1, RECORD_NAME_SIZE - 1);
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (strncmp(line, "#c4 ", 4) != 0)
+        {
+            if (!isWhitespace(line))
+            {
+                fprintf(stderr, "Skipping a line that is not a game record\n");
+            }
+
+            continue;
+        }
+
+        memset(record, 0, sizeof(*record));
+        fields = sscanf(line, format, size, record->result,
+                record->players[0], record->players[1], record->date);
+
+        if (fgets(moves, sizeof(moves), file) == NULL)
+        {
+            moves[0] = '\0';
+        }
+
+        moves[strcspn(moves, "\r\n")] = '\0';
+        snprintf(line, sizeof(line), "%dx%d", COLS, ROWS);
+
+        if (fields < 4 || strcmp(size, line) != 0
+                || strlen(moves) > CELLS)
+        {
+            fprintf(stderr, "Skipping a game record for another board\n");
+            continue;
+        }
+
+        /* Every move must be legal, and only the last may end the game */
+        initPosition(&pos);
+        over = false;
+
+        for (i = 0; moves[i] != '\0' && !over; i++)
+        {
+            if (moves[i] < '1' || moves[i] > '0' + COLS
+                    || !canPlay(&pos, moves[i] - '1'))
+            {
+                break;
+            }
+
+            over = placePiece(&pos, moves[i] - '1');
+        }
+
+        if (moves[i] != '\0')
+        {
+            fprintf(stderr, "Skipping a game record with invalid moves: %s\n",
+                    moves);
+            continue;
+        }
+
+        strcpy(record->moves, moves);
+        return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Annotate games until there are none left.
+ *
+ * params:
+ * arg: the Annotator
+ *
+ * returns:
+ * NULL
+ */
+static void *annotateGames(void *arg)
+{
+    Annotator *annotator = (Annotator *)arg;
+    SearchResult result;
+    MoveNote *note = NULL;
+    Position pos;
+    size_t game = 0;
+    int i = 0;
+    int col = 0;
+
+    while ((game = atomic_fetch_add(&annotator->next, 1)) < annotator->count)
+    {
+        initPosition(&pos);
+
+        for (i = 0; annotator->records[game].moves[i] != '\0'; i++)
+        {
+            note = &annotator->notes[game][i];
+            col = annotator->records[game].moves[i] - '1';
+
+            searchPosition(&pos, &annotator->limits, annotator->tt, &result);
+            atomic_fetch_add(&annotator->nodes, result.nodes);
+            note->bestMove = result.bestMove;
+            note->bestScore = result.score;
+
+            if (col == result.bestMove || isWinningMove(&pos, col))
+            {
+                note->score = isWinningMove(&pos, col)
+                        ? WIN_SCORE - (int)pos.moves - 1 : result.score;
+                placePiece(&pos, col);
+                continue;
+            }
+
+            placePiece(&pos, col);
+
+            if (isBoardFull(&pos))
+            {
+                note->score = 0;
+                continue;
+            }
+
+            searchPosition(&pos, &annotator->replyLimits, annotator->tt,
+                    &result);
+            atomic_fetch_add(&annotator->nodes, result.nodes);
+            note->score = -result.score;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Get the kind of outcome a score promises: 1 for a forced win, -1 for a
+ * forced loss, and 0 when neither has been found.
+ *
+ * params:
+ * score: the score
+ *
+ * returns:
+ * the outcome
+ */
+static int outcome(int score)
+{
+    return (score > WIN_SCORE - CELLS - 1) - (score < -(WIN_SCORE - CELLS - 1));
+}
+
+
+/*
+ * Annotate every game of a record file and write the games with the score
+ * of each move, for the player who made it:
+ *
+ * #c4 ... (the header of the game)
+ * <col><mark>:<score> ...
+ *
+ * where the mark is "??" for a blunder and "?" for a mistake, followed by
+ * "(<best col>:<best score>)". A summary goes to the standard error.
+ *
+ * The search depth is the same for every move, so the annotation takes the
+ * same time and gives the same marks however busy the machine is.
+ *
+ * params:
+ * path: the record file, or "-" for the standard input
+ * engine: the computer player whose table and tablebase are used
+ * depth: moves each position is searched ahead
+ * threads: number of worker threads
+ *
+ * returns:
+ * true if the games were annotated, false otherwise
+ */
+bool annotateFile(const char *path, Engine *engine, int depth, int threads)
+{
+    Annotator annotator;
+    GameRecord *grown = NULL;
+    pthread_t *workers = NULL;
+    const MoveNote *note = NULL;
+    FILE *input = stdin;
+    size_t capacity = 0;
+    size_t game = 0;
+    size_t moves = 0;
+    size_t blunders = 0;
+    size_t mistakes = 0;
+    double startTime = getTime();
+    double seconds = 0;
+    int started = 0;
+    int i = 0;
+    bool ready = true;
+
+    memset(&annotator, 0, sizeof(annotator));
+    annotator.tt = &engine->tt;
+    annotator.limits.depth = depth;
+    annotator.limits.threads = 1;
+    annotator.limits.tablebase = engine->limits.tablebase;
+    annotator.replyLimits = annotator.limits;
+
+    /* The reply is searched a move less deep, so both scores look as far
+       ahead */
+    if (depth > 1)
+    {
+        annotator.replyLimits.depth = depth - 1;
+    }
+    atomic_init(&annotator.next, 0);
+    atomic_init(&annotator.nodes, 0);
+
+    if (strcmp(path, "-") != 0)
+    {
+        input = fopen(path, "r");
+
+        if (input == NULL)
+        {
+            perror(path);
+            return false;
+        }
+    }
+
+    while (ready)
+    {
+        if (annotator.count == capacity)
+        {
+            capacity = capacity > 0 ? 2 * capacity : 1024;
+            grown = (GameRecord *)realloc(annotator.records,
+                    capacity * sizeof(GameRecord));
+            ready = grown != NULL;
+
+            if (ready)
+            {
+                annotator.records = grown;
+            }
+        }
+
+        if (ready && !recordRead(input, &annotator.records[annotator.count]))
+        {
+            break;
+        }
+
+        annotator.count += ready;
+    }
+
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+
+    annotator.notes = (MoveNote (*)[CELLS])calloc(annotator.count + 1,
+            sizeof(*annotator.notes));
+    workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    ready = ready && annotator.notes != NULL && workers != NULL;
+
+    for (i = 0; ready && i < threads; i++)
+    {
+        if (pthread_create(&workers[started], NULL, annotateGames,
+                &annotator) == 0)
+        {
+            started++;
+        }
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    seconds = getTime() - startTime;
+    ready = ready && started > 0;
+
+    for (game = 0; ready && game < annotator.count; game++)
+    {
+        writeHeader(stdout, &annotator.records[game]);
+
+        for (i = 0; annotator.records[game].moves[i] != '\0'; i++)
+        {
+            note = &annotator.notes[game][i];
+            printf("%s%c", i > 0 ? " " : "", annotator.records[game].moves[i]);
+
+            if (outcome(note->score) < outcome(note->bestScore))
+            {
+                printf("??");
+                blunders++;
+            }
+            else if (outcome(note->bestScore) == 0 && outcome(note->score) == 0
+                    && note->score <= note->bestScore - ANNOTATE_MISTAKE)
+            {
+                printf("?");
+                mistakes++;
+            }
+
+            printf(":%d", note->score);
+
+            if (note->score < note->bestScore)
+            {
+                printf("(%d:%d)", note->bestMove + 1, note->bestScore);
+            }
+
+            moves++;
+        }
+
+        printf("\n");
+    }
+
+    if (ready)
+    {
+        fprintf(stderr, "Annotated %zu games, %zu moves in %.3f s "
+                "(%.0f moves/s, %.0f nodes/s): %zu blunders, %zu mistakes\n",
+                annotator.count, moves, seconds,
+                seconds > 0 ? moves / seconds : 0.0,
+                seconds > 0 ? atomic_load(&annotator.nodes) / seconds : 0.0,
+                blunders, mistakes);
+    }
+    else
+    {
+        fprintf(stderr, "Could not annotate the games\n");
+    }
+
+    free(workers);
+    free(annotator.notes);
+    free(annotator.records);
+
+    return ready;
+}
@@ -0,0 +1,928 @@
+/*
+ * Game tree search for the computer player.
+ *
+ * Positions are scored with negamax: the score is always from the point of
+ * view of the player to move, and the score of a move is the negated score
+ * of the position it leads to. Alpha-beta pruning skips moves that cannot
+ * change the result, given the best scores both players can already force.
+ *
+ * A win scores WIN_SCORE minus the number of pieces on the board once the
+ * winning piece is placed, so faster wins score higher and slower losses
+ * score higher than faster ones. A draw scores 0, and a position at the
+ * search horizon scores what evaluate() makes of it.
+ *
+ * The computer player deepens its search one move at a time until it runs
+ * out of time, and plays the best move of the deepest search it completed.
+ * Each iteration fills the transposition table with best moves that make the
+ * next one cheaper, so little is lost by starting shallow.
+ *
+ * With more than one thread the search is "lazy SMP": helper threads search
+ * the same position at staggered depths, sharing the transposition table
+ * with the main thread, and their results are thrown away. The helpers
+ * fill the table with scores and best moves the main thread then finds
+ * instead of searching them itself.
+ *
+ * Alpha-beta prunes the most when the best move is searched first, so moves
+ * are ordered: the best move stored in the transposition table first, then
+ * the others nearest the centre first, where a piece is part of more lines
+ * of four. The two columns equally far from the centre are ordered by the
+ * killer moves (the last moves to cause a cutoff at the same ply), then by
+ * their history (how often each move has caused a cutoff, weighted by depth).
+ * Letting killers and history override the centre order raises the rate of
+ * cutoffs by the first move, but grows the tree: searching moves in the same
+ * order everywhere lets the transposition table catch more transpositions.
+ */
+
+
+#include "c4.h"
+
+
+/* Layout of the move priorities of orderMoves() */
+#define CENTER_SHIFT 24         // closeness to the centre, above the rest
+#define KILLER_SHIFT 22         // two bits, one per killer move
+#define HISTORY_LIMIT (1 << 22) // history is halved when a count passes this
+
+
+/* Positions searched by benchmarkThreads(), as moves from the start */
+static const char *benchPositions[] =
+{
+    "4453",
+    "44433352",
+    "4453342256",
+    "1234567",
+    "4444",
+    "435526"
+};
+
+
+/* A helper thread of a parallel search */
+typedef struct
+{
+    pthread_t thread;
+    Position pos;                   // the helper's own copy of the position
+    SearchContext ctx;
+    SearchResult result;
+    int firstDepth;                 // depth of the helper's first iteration
+    int maxDepth;                   // depth of the helper's last iteration
+}
+HelperThread;
+
+
+/*
+ * Get the current value of a monotonic clock.
+ *
+ * returns:
+ * the time in seconds
+ */
+double getTime()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/*
+ * Prepare a search context with no killer moves and an empty history.
+ *
+ * params:
+ * ctx: the context to prepare
+ * tt: the transposition table of the search
+ * result: where the statistics of the search are counted
+ */
+void initSearchContext(SearchContext *ctx, TranspositionTable *tt,
+        SearchResult *result)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    memset(ctx->killers, -1, sizeof(ctx->killers));
+    ctx->tt = tt;
+    ctx->result = result;
+}
+
+
+/*
+ * Put the moves of a position in the order they should be searched: the
+ * given first move, then the others nearest the centre first. Of two moves
+ * equally far from the centre, a killer move of the ply goes first, and
+ * otherwise the move with more history.
+ *
+ * params:
+ * pos: the position
+ * ctx: the killer moves and history of the search
+ * firstMove: the move to search first, or -1 if none
+ * moves: where the ordered columns are stored
+ *
+ * returns:
+ * the number of moves
+ */
+int orderMoves(const Position *pos, const SearchContext *ctx, int firstMove,
+        int moves[COLS])
+{
+    const unsigned int *history = ctx->history[pos->moves & 1];
+    unsigned int priorities[COLS];
+    unsigned int priority = 0;
+    int count = 0;
+    int col = 0;
+    int i = 0;
+    int j = 0;
+
+    for (i = 0; i < COLS; i++)
+    {
+        col = CENTER_ORDER(i);
+
+        if (!canPlay(pos, col))
+        {
+            continue;
+        }
+
+        priority = (unsigned int)(COLS - (i + 1) / 2) << CENTER_SHIFT
+                | history[col * BOARD_HEIGHT + pos->height[col]];
+
+        if (col == firstMove)
+        {
+            priority = UINT_MAX;
+        }
+        else if (col == ctx->killers[pos->moves][0])
+        {
+            priority |= 2u << KILLER_SHIFT;
+        }
+        else if (col == ctx->killers[pos->moves][1])
+        {
+            priority |= 1u << KILLER_SHIFT;
+        }
+
+        /* Insertion sort, keeping the centre order between equal moves */
+        for (j = count; j > 0 && priorities[j - 1] < priority; j--)
+        {
+            priorities[j] = priorities[j - 1];
+            moves[j] = moves[j - 1];
+        }
+
+        priorities[j] = priority;
+        moves[j] = col;
+        count++;
+    }
+
+    return count;
+}
+
+
+/*
+ * Remember a move that caused a cutoff, as a killer move of its ply and in
+ * the history of the player who made it.
+ *
+ * params:
+ * pos: the position the move was made in
+ * ctx: the killer moves and history of the search
+ * col: the move
+ * depth: the depth the position was searched to
+ */
+void recordCutoff(const Position *pos, SearchContext *ctx, int col, int depth)
+{
+    signed char *killers = ctx->killers[pos->moves];
+    unsigned int *history = ctx->history[pos->moves & 1];
+    int cell = col * BOARD_HEIGHT + pos->height[col];
+    int i = 0;
+
+    if (killers[0] != col)
+    {
+        killers[1] = killers[0];
+        killers[0] = col;
+    }
+
+    history[cell] += depth * depth;
+
+    /* Age the history of the player before it can overflow */
+    if (history[cell] >= HISTORY_LIMIT)
+    {
+        for (i = 0; i < COLS * BOARD_HEIGHT; i++)
+        {
+            history[i] /= 2;
+        }
+    }
+}
+
+
+/*
+ * Score a position with negamax search and alpha-beta pruning.
+ *
+ * The returned score is exact if it lies strictly between alpha and beta.
+ * Otherwise it is an upper bound (score <= alpha) or a lower bound
+ * (score >= beta) of the exact score.
+ *
+ * Positions in the endgame tablebase, if there is one, are scored exactly
+ * from it instead of searched.
+ *
+ * Every searched position is stored in the transposition table. When the
+ * table already holds a result searched at least as deep that settles the
+ * position for this window, it is returned without searching; otherwise its
+ * best move is searched first, since it is the most likely to cause a cutoff.
+ * The other moves are ordered by orderMoves().
+ *
+ * params:
+ * pos: the position to score, restored before returning
+ * depth: number of moves to look ahead
+ * alpha: score the player to move is already guaranteed
+ * beta: score the opponent is already guaranteed, negated
+ * ctx: the transposition table, deadline and statistics of the search
+ *
+ * returns:
+ * the score of the position for the player to move, or 0 if the search
+ * ran out of time or was stopped
+ */
+int negamax(Position *pos, int depth, int alpha, int beta, SearchContext *ctx)
+{
+    uint64_t key = 0;
+    bool mirrored = false;          // is the key of the mirror image?
+    TTData stored;
+    int moves[COLS];
+    int moveCount = 0;
+    int originalAlpha = alpha;
+    int bestScore = -WIN_SCORE;
+    int bestMove = -1;
+    int firstMove = -1;
+    int i = 0;
+    int col = 0;
+    int score = 0;
+
+    ctx->result->nodes++;
+
+    if (ctx->deadline > 0 && ctx->result->nodes % CLOCK_CHECK_NODES == 0
+            && getTime() >= ctx->deadline)
+    {
+        ctx->aborted = true;
+    }
+
+    if (ctx->stop != NULL
+            && atomic_load_explicit(ctx->stop, memory_order_relaxed))
+    {
+        ctx->aborted = true;
+    }
+
+    if (ctx->aborted)
+    {
+        return 0;
+    }
+
+    if (isBoardFull(pos))
+    {
+        return 0;
+    }
+
+    /* A win right now cannot be improved on */
+    for (col = 0; col < COLS; col++)
+    {
+        if (canPlay(pos, col) && isWinningMove(pos, col))
+        {
+            return WIN_SCORE - (int)pos->moves - 1;
+        }
+    }
+
+    /* Nor can the exact score of an endgame */
+    if (ctx->tablebase != NULL
+            && tablebaseProbe(ctx->tablebase, pos, &score))
+    {
+        ctx->result->tbHits++;
+        return score;
+    }
+
+    if (depth == 0)
+    {
+        return evaluate(pos);
+    }
+
+    key = canonicalKey(pos, &mirrored);
+
+    if (ttProbe(ctx->tt, key, &stored, ctx->result))
+    {
+        if (stored.depth >= depth
+                && (stored.bound == BOUND_EXACT
+                    || (stored.bound == BOUND_LOWER && stored.score >= beta)
+                    || (stored.bound == BOUND_UPPER && stored.score <= alpha)))
+        {
+            return stored.score;
+        }
+
+        firstMove = stored.bestMove;
+
+        if (mirrored && firstMove >= 0)
+        {
+            firstMove = MIRROR_COLUMN(firstMove);
+        }
+    }
+
+    moveCount = orderMoves(pos, ctx, firstMove, moves);
+
+    for (i = 0; i < moveCount && alpha < beta; i++)
+    {
+        col = moves[i];
+
+        playMove(pos, col);
+        score = -negamax(pos, depth - 1, -beta, -alpha, ctx);
+        undoMove(pos, col);
+
+        if (ctx->aborted)
+        {
+            return 0;
+        }
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestMove = col;
+
+            if (score > alpha)
+            {
+                alpha = score;
+            }
+        }
+    }
+
+    if (bestScore >= beta)
+    {
+        ctx->result->cutoffs++;
+        ctx->result->firstCutoffs += (i == 1);
+        recordCutoff(pos, ctx, bestMove, depth);
+    }
+
+    /* Moves are stored as they are played in the position of the key */
+    if (mirrored && bestMove >= 0)
+    {
+        bestMove = MIRROR_COLUMN(bestMove);
+    }
+
+    if (bestScore <= originalAlpha)
+    {
+        ttStore(ctx->tt, key, bestScore, depth, BOUND_UPPER, bestMove);
+    }
+    else if (bestScore >= beta)
+    {
+        ttStore(ctx->tt, key, bestScore, depth, BOUND_LOWER, bestMove);
+    }
+    else
+    {
+        ttStore(ctx->tt, key, bestScore, depth, BOUND_EXACT, bestMove);
+    }
+
+    return bestScore;
+}
+
+
+/*
+ * Search every move of a position to a fixed depth. The board must not be
+ * full.
+ *
+ * The best move of the previous iteration, if any, is searched first, then
+ * the other moves nearest the centre first. The result is only updated if
+ * the search completes before the deadline.
+ *
+ * params:
+ * pos: the position to search, restored before returning
+ * depth: number of moves to look ahead, at least 1
+ * ctx: the transposition table, deadline and result of the search
+ *
+ * returns:
+ * true if the search completed, false if it ran out of time
+ */
+bool searchRoot(Position *pos, int depth, SearchContext *ctx)
+{
+    int firstMove = ctx->result->bestMove;
+    int alpha = -WIN_SCORE;
+    int bestMove = -1;
+    int move = 0;
+    int col = 0;
+    int score = 0;
+
+    for (move = -1; move < COLS; move++)
+    {
+        col = (move < 0) ? firstMove : CENTER_ORDER(move);
+
+        if (col < 0 || (move >= 0 && col == firstMove) || !canPlay(pos, col))
+        {
+            continue;
+        }
+
+        if (isWinningMove(pos, col))
+        {
+            score = WIN_SCORE - (int)pos->moves - 1;
+        }
+        else
+        {
+            playMove(pos, col);
+            score = -negamax(pos, depth - 1, -WIN_SCORE, -alpha, ctx);
+            undoMove(pos, col);
+
+            if (ctx->aborted)
+            {
+                return false;
+            }
+        }
+
+        if (bestMove < 0 || score > alpha)
+        {
+            alpha = score;
+            bestMove = col;
+        }
+    }
+
+    ctx->result->bestMove = bestMove;
+    ctx->result->score = alpha;
+    ctx->result->depth = depth;
+
+    return true;
+}
+
+
+/*
+ * Search a position with iterative deepening in a helper thread, until the
+ * last iteration is done or the main thread stops it.
+ *
+ * params:
+ * arg: the HelperThread
+ *
+ * returns:
+ * NULL
+ */
+static void *helperSearch(void *arg)
+{
+    HelperThread *helper = (HelperThread *)arg;
+    int depth = 0;
+
+    for (depth = helper->firstDepth;
+            depth <= helper->maxDepth && !helper->ctx.aborted; depth++)
+    {
+        helper->result.nodes++;
+        searchRoot(&helper->pos, depth, &helper->ctx);
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Add the statistics of one thread's search to those of another.
+ *
+ * params:
+ * total: the statistics to add to
+ * part: the statistics to add
+ */
+static void addStatistics(SearchResult *total, const SearchResult *part)
+{
+    total->nodes += part->nodes;
+    total->ttProbes += part->ttProbes;
+    total->ttHits += part->ttHits;
+    total->ttCollisions += part->ttCollisions;
+    total->tbHits += part->tbHits;
+    total->cutoffs += part->cutoffs;
+    total->firstCutoffs += part->firstCutoffs;
+}
+
+
+/*
+ * Follow the best moves stored in the transposition table from a position,
+ * starting with the best move of a search, to find the line of play the
+ * search expects. The line ends where the table has no move, at the end of
+ * the game, or at the depth of the search, beyond which stored moves come
+ * from other searches. Its table lookups are not counted in the statistics.
+ *
+ * params:
+ * pos: the searched position, restored before returning
+ * tt: the transposition table of the search
+ * result: the result of the search, where the line is stored
+ */
+static void findPrincipalVariation(Position *pos, const TranspositionTable *tt,
+        SearchResult *result)
+{
+    SearchResult uncounted = {0};   // counts the lookups of the line
+    TTData stored;
+    bool mirrored = false;
+    int col = result->bestMove;
+    int played = 0;
+
+    result->pvLength = 0;
+
+    while (col >= 0 && canPlay(pos, col) && result->pvLength < result->depth)
+    {
+        result->pv[result->pvLength++] = col;
+
+        if (isWinningMove(pos, col))
+        {
+            break;
+        }
+
+        playMove(pos, col);
+        played++;
+        col = -1;
+
+        if (ttProbe(tt, canonicalKey(pos, &mirrored), &stored, &uncounted)
+                && stored.bestMove >= 0)
+        {
+            col = mirrored ? MIRROR_COLUMN(stored.bestMove) : stored.bestMove;
+        }
+    }
+
+    while (played > 0)
+    {
+        undoMove(pos, result->pv[--played]);
+    }
+}
+
+
+/*
+ * Find the best move for the player to move with iterative deepening: the
+ * position is searched to depth 1, 2, 3, ... until the depth or time limit
+ * is reached. The board must not be full.
+ *
+ * The first iteration always completes, so there is always a move to play.
+ * Setting the stop flag of the limits ends the search like the deadline.
+ * Deepening also stops once a forced win or loss is found, or once the
+ * search reaches the end of the game, since looking further cannot change
+ * the result.
+ *
+ * When more than one thread is asked for, helper threads are started on
+ * copies of the position, every other one starting a depth ahead so the
+ * helpers do not all work on the same iteration. They run until the main
+ * thread finishes, and their node and table counts are added to the result.
+ * Every thread counts into its own result, so the counts cost no
+ * contention while the threads search.
+ *
+ * params:
+ * pos: the position to search, restored before returning
+ * limits: the deepest iteration, time limit, threads and stop flag
+ * tt: the transposition table to use
+ * result: where the best move, its score and the search statistics are stored
+ */
+void searchPosition(Position *pos, const SearchLimits *limits,
+        TranspositionTable *tt, SearchResult *result)
+{
+    SearchContext ctx;
+    HelperThread *helpers = NULL;
+    atomic_bool stop = false;
+    double startTime = getTime();
+    int maxDepth = CELLS - pos->moves;
+    unsigned long long previousNodes = 0;   // nodes before the last iteration
+    unsigned long long iterationNodes = 0;  // nodes of the last iteration
+    double iterationStart = 0;
+    int helperCount = 0;
+    int depth = 0;
+    int i = 0;
+    bool finished = false;
+
+    memset(result, 0, sizeof(*result));
+    result->bestMove = -1;
+    initSearchContext(&ctx, tt, result);
+    ctx.tablebase = limits->tablebase;
+
+    if (limits->depth > 0 && limits->depth < maxDepth)
+    {
+        maxDepth = limits->depth;
+    }
+
+    if (limits->threads > 1)
+    {
+        helpers = (HelperThread *)calloc(limits->threads - 1,
+                sizeof(HelperThread));
+    }
+
+    for (i = 0; helpers != NULL && i < limits->threads - 1; i++)
+    {
+        helpers[i].pos = *pos;
+        initSearchContext(&helpers[i].ctx, tt, &helpers[i].result);
+        helpers[i].ctx.stop = &stop;
+        helpers[i].ctx.tablebase = limits->tablebase;
+        helpers[i].result.bestMove = -1;
+        helpers[i].firstDepth = 1 + (i + 1) % 2;
+        helpers[i].maxDepth = maxDepth;
+
+        if (pthread_create(&helpers[i].thread, NULL, helperSearch,
+                &helpers[i]) != 0)
+        {
+            break;              // search with the helpers already started
+        }
+
+        helperCount++;
+    }
+
+    for (depth = 1; depth <= maxDepth && !finished; depth++)
+    {
+        previousNodes = result->nodes;
+        iterationStart = getTime();
+        result->nodes++;
+        finished = !searchRoot(pos, depth, &ctx)
+                || abs(result->score) > WIN_SCORE - CELLS - 1;
+
+        if (!ctx.aborted)
+        {
+            result->iterationSeconds[depth - 1] = getTime() - iterationStart;
+
+            if (iterationNodes > 0)
+            {
+                result->branchingFactor = (double)(result->nodes
+                        - previousNodes) / iterationNodes;
+            }
+
+            iterationNodes = result->nodes - previousNodes;
+        }
+
+        /* Only the first iteration is safe from the deadline and stop flag */
+        ctx.stop = limits->stop;
+
+        if (limits->timeLimit > 0)
+        {
+            ctx.deadline = startTime + limits->timeLimit / 1000.0;
+            finished = finished || getTime() >= ctx.deadline;
+        }
+    }
+
+    atomic_store(&stop, true);
+
+    for (i = 0; i < helperCount; i++)
+    {
+        pthread_join(helpers[i].thread, NULL);
+        addStatistics(result, &helpers[i].result);
+    }
+
+    free(helpers);
+    findPrincipalVariation(pos, tt, result);
+    result->seconds = getTime() - startTime;
+}
+
+
+/*
+ * Score every move of a position to a fixed depth. Unlike searchRoot(),
+ * every move is searched with the full window, so each score is exact at the
+ * depth and not only a bound showing the move is no better than the best.
+ * The moves are searched with one context, so the later ones find the
+ * transpositions, killers and history of the earlier ones. The board must
+ * not be full.
+ *
+ * params:
+ * pos: the position to search, restored before returning
+ * depth: number of moves to look ahead, at least 1
+ * ctx: the transposition table, deadline and result of the search
+ * scores: where the score of each column is stored, left as it was for
+ *         columns that cannot be played
+ *
+ * returns:
+ * true if the search completed, false if it ran out of time
+ */
+static bool analyseRoot(Position *pos, int depth, SearchContext *ctx,
+        int scores[COLS])
+{
+    int newScores[COLS];
+    int bestMove = -1;
+    int move = 0;
+    int col = 0;
+
+    memcpy(newScores, scores, sizeof(newScores));
+
+    for (move = 0; move < COLS; move++)
+    {
+        col = CENTER_ORDER(move);
+
+        if (!canPlay(pos, col))
+        {
+            continue;
+        }
+
+        if (isWinningMove(pos, col))
+        {
+            newScores[col] = WIN_SCORE - (int)pos->moves - 1;
+        }
+        else
+        {
+            playMove(pos, col);
+            newScores[col] = -negamax(pos, depth - 1, -WIN_SCORE, WIN_SCORE,
+                    ctx);
+            undoMove(pos, col);
+
+            if (ctx->aborted)
+            {
+                return false;
+            }
+        }
+
+        if (bestMove < 0 || newScores[col] > newScores[bestMove])
+        {
+            bestMove = col;
+        }
+    }
+
+    memcpy(scores, newScores, sizeof(newScores));
+    ctx->result->bestMove = bestMove;
+    ctx->result->score = newScores[bestMove];
+    ctx->result->depth = depth;
+
+    return true;
+}
+
+
+/*
+ * Score every move of a position, for analysis: like searchPosition(), but
+ * giving the exact score of each column instead of only the best one. The
+ * position is searched with iterative deepening within the depth and time
+ * limits, and the scores are those of the deepest iteration completed, which
+ * are all from the same depth. The board must not be full.
+ *
+ * Searching each move after another in one table costs far less than
+ * searching the positions after each move on their own: the positions they
+ * share are searched once, and every iteration starts with the best moves
+ * of the one before. The analysis runs on one thread, whatever the limits
+ * ask for.
+ *
+ * params:
+ * pos: the position to analyse, restored before returning
+ * limits: the deepest iteration, time limit and stop flag
+ * tt: the transposition table to use
+ * analysis: where the scores of the columns, the best move and the
+ *           statistics of the search are stored
+ */
+void analysePosition(Position *pos, const SearchLimits *limits,
+        TranspositionTable *tt, Analysis *analysis)
+{
+    SearchResult *result = &analysis->result;
+    SearchContext ctx;
+    double startTime = getTime();
+    int maxDepth = CELLS - pos->moves;
+    int depth = 0;
+    int col = 0;
+    bool finished = false;
+    bool decided = false;           // is every move a forced win or loss?
+
+    memset(analysis, 0, sizeof(*analysis));
+    result->bestMove = -1;
+    initSearchContext(&ctx, tt, result);
+    ctx.tablebase = limits->tablebase;
+
+    for (col = 0; col < COLS; col++)
+    {
+        analysis->playable[col] = canPlay(pos, col);
+    }
+
+    if (limits->depth > 0 && limits->depth < maxDepth)
+    {
+        maxDepth = limits->depth;
+    }
+
+    for (depth = 1; depth <= maxDepth && !finished; depth++)
+    {
+        result->nodes++;
+        finished = !analyseRoot(pos, depth, &ctx, analysis->scores);
+        decided = true;
+
+        for (col = 0; col < COLS; col++)
+        {
+            decided = decided && (!analysis->playable[col]
+                    || abs(analysis->scores[col]) > WIN_SCORE - CELLS - 1);
+        }
+
+        finished = finished || decided;
+
+        /* Only the first iteration is safe from the deadline and stop flag */
+        ctx.stop = limits->stop;
+
+        if (limits->timeLimit > 0)
+        {
+            ctx.deadline = startTime + limits->timeLimit / 1000.0;
+            finished = finished || getTime() >= ctx.deadline;
+        }
+    }
+
+    findPrincipalVariation(pos, tt, result);
+    result->seconds = getTime() - startTime;
+}
+
+
+/*
+ * Search a position in the background until the search is stopped.
+ *
+ * params:
+ * arg: the Ponder
+ *
+ * returns:
+ * NULL
+ */
+static void *ponderSearch(void *arg)
+{
+    Ponder *ponder = (Ponder *)arg;
+
+    searchPosition(&ponder->pos, &ponder->limits, ponder->tt, &ponder->result);
+    return NULL;
+}
+
+
+/*
+ * Start searching a position on the opponent's time: while the opponent
+ * thinks about their move, the position is searched deeper and deeper with
+ * the computer's threads and transposition table, until stopPondering() is
+ * called or the search reaches the end of the game. Whatever move the
+ * opponent makes, the table then already holds scores and best moves for
+ * the position after it, so the computer's own search gets further in its
+ * thinking time. The board must not be full.
+ *
+ * params:
+ * ponder: where the background search is kept
+ * pos: the position the opponent is to move in
+ * engine: the computer player whose limits and table are used
+ *
+ * returns:
+ * true if the search was started, false otherwise
+ */
+bool startPondering(Ponder *ponder, const Position *pos, Engine *engine)
+{
+    ponder->pos = *pos;
+    ponder->limits = engine->limits;
+    ponder->limits.depth = 0;
+    ponder->limits.timeLimit = 0;
+    ponder->limits.stop = &ponder->stop;
+    ponder->tt = &engine->tt;
+    atomic_init(&ponder->stop, false);
+    ponder->running = pthread_create(&ponder->thread, NULL, ponderSearch,
+            ponder) == 0;
+
+    return ponder->running;
+}
+
+
+/*
+ * End a search started by startPondering(), if it is running, and wait for
+ * it.
+ *
+ * params:
+ * ponder: the background search
+ */
+void stopPondering(Ponder *ponder)
+{
+    if (ponder->running)
+    {
+        atomic_store(&ponder->stop, true);
+        pthread_join(ponder->thread, NULL);
+        ponder->running = false;
+    }
+}
+
+
+/*
+ * Compare the speed of the search with one thread and with the number of
+ * threads chosen for the computer player, over a fixed set of positions.
+ *
+ * Each position is searched to a fixed depth with no time limit, starting
+ * from an empty transposition table, so both runs do the same job.
+ *
+ * params:
+ * engine: the computer player whose depth, threads and table are used
+ */
+void benchmarkThreads(Engine *engine)
+{
+    int positionCount = sizeof(benchPositions) / sizeof(benchPositions[0]);
+    int threadCounts[2] = {1, engine->limits.threads};
+    double totalSeconds[2] = {0, 0};
+    double seconds[2] = {0, 0};
+    SearchLimits limits = {.depth = BENCH_DEPTH, .threads = 1};
+    SearchResult result;
+    Position pos;
+    int i = 0;
+    int run = 0;
+
+    if (engine->limits.depth > 0)
+    {
+        limits.depth = engine->limits.depth;
+    }
+
+    printf("Depth %d, %d thread(s) against 1\n\n", limits.depth,
+            threadCounts[1]);
+    printf("%-14s %12s %12s %8s\n", "Position", "1 thread", "N threads",
+            "Speedup");
+
+    for (i = 0; i < positionCount; i++)
+    {
+        for (run = 0; run < 2; run++)
+        {
+            initPosition(&pos);
+
+            if (!playMoves(&pos, benchPositions[i]))
+            {
+                break;              // too many columns for this board size
+            }
+
+            ttClear(&engine->tt);
+            limits.threads = threadCounts[run];
+            searchPosition(&pos, &limits, &engine->tt, &result);
+            seconds[run] = result.seconds;
+            totalSeconds[run] += result.seconds;
+        }
+
+        if (run < 2)
+        {
+            continue;
+        }
+
+        printf("%-14s %11.3fs %11.3fs %7.2fx\n", benchPositions[i],
+                seconds[0], seconds[1], seconds[0] / seconds[1]);
+    }
+
+    printf("%-14s %11.3fs %11.3fs %7.2fx\n", "Total",
+            totalSeconds[0], totalSeconds[1],
+            totalSeconds[0] / totalSeconds[1]);
+}
@@ -0,0 +1,1233 @@
+/*
+ * Game server: many games at once, played by clients over a Unix socket.
+ *
+ * Clients connect to the socket and send commands one per line, much like
+ * the text protocol (see protocol.c), except that every command after "new"
+ * names the game it is for, so one client can play many games and a game
+ * can be played by any client that knows its id. Columns count from 1.
+ *
+ * new [moves]          start a game, from the moves if given. Answers
+ *                      "game <id>"
+ * play <id> <col>      play a move. Answers "played <id> <col>", followed
+ *                      by " won" or " drawn" if the move ends the game
+ * go <id> [depth N] [time MS]
+ *                      let the engine play a move, with the engine's limits
+ *                      unless given. Answers, once the search ends:
+ *                      move <id> <col> score <score> depth <depth>
+ *                      nodes <nodes> time <ms> [won|drawn]
+ *                      or "move <id> <col> score <score> book [won|drawn]"
+ * stop <id>            end the search of a game, which then plays its best
+ *                      move and answers as for go
+ * show <id>            answers "position <id> <moves>"
+ * end <id>             forget a game. Answers "ended <id>"
+ * stats                answers "stats games <n> clients <n> searches <n>
+ *                      moves <n> p50 <ms> p99 <ms>", the time taken to
+ *                      answer the last SERVER_LATENCIES searches
+ *
+ * Commands that cannot be carried out answer "error <reason>". Answers to
+ * "go" come when the search ends, so they may come after answers to later
+ * commands; every answer names its game. A game takes no other commands
+ * while the engine searches for its move.
+ *
+ * Games live in a slab of slots allocated when the server starts, so an
+ * idle game costs its slot and nothing else: 136 bytes on a 7x6 board, or
+ * 1.3 MB for ten thousand games. Free slots are chained into a list. A game
+ * id is its slot plus the number of slots times the number of times the
+ * slot was reused, so the id of an ended game never finds a new one.
+ * Clients live in a slab of SERVER_CLIENTS slots of their own, each with
+ * buffers for a line of input and for the answers not yet sent.
+ *
+ * One thread serves every client: it waits on all the sockets at once with
+ * epoll, reads and carries out whole lines, and writes answers as far as
+ * the socket takes them, without ever blocking. A client that sends
+ * commands faster than it reads the answers is not read from until its
+ * answers have been taken. Searches go to a fixed pool of -j worker threads
+ * through a queue, and every worker searches on one thread with the
+ * engine's transposition table, which they all share. A worker that ends a
+ * search queues the game back and wakes the serving thread through an
+ * eventfd, and the serving thread plays the move and answers the client.
+ *
+ * To keep the time to answer "go" bounded under load, at most
+ * SERVER_QUEUE_SIZE searches can wait or run at once, and further requests
+ * are refused. Every search has a time limit, even with a depth: the one
+ * asked for, or else the engine's, or THINK_TIME if the engine has none, and
+ * never more than MAX_SERVER_TIME. The time a search waited in the queue is
+ * taken off its limit, so its answer comes within the limit unless the
+ * queue is longer than the limit itself. The server runs until it is
+ * interrupted or terminated, and then removes its socket.
+ */
+
+
+#include "c4.h"
+
+
+/* Tags of the epoll events that are not from clients */
+#define LISTENER_EVENT UINT64_MAX
+#define WAKE_EVENT (UINT64_MAX - 1)
+
+
+/* A game of the slab */
+typedef struct
+{
+    Position pos;
+    char moves[CELLS + 1];          // the moves played, as columns from '1'
+    bool used;                      // is the slot a game?
+    bool busy;                      // is a search of the game queued or
+                                    // running?
+    bool over;                      // has the game been won or drawn?
+    atomic_bool stop;               // set to end the search early
+    uint32_t generation;            // times the slot has been reused
+    int nextFree;                   // next free slot, if the slot is free
+    int client;                     // client the search answers to
+    uint32_t clientGeneration;      // generation of that client
+    int depth;                      // depth limit of the search
+    int timeLimit;                  // time limit of the search
+    double queued;                  // clock time the search was asked for
+    int bestMove;                   // result of the search
+    int score;
+    int reached;                    // depth the search reached
+    unsigned long long nodes;
+}
+ServerGame;
+
+
+/* A client of the server */
+typedef struct
+{
+    int fd;                         // socket, or -1 if the slot is free
+    uint32_t generation;            // times the slot has been reused
+    int nextFree;                   // next free slot, if the slot is free
+    bool discarding;                // skipping the rest of a long line?
+    bool stalled;                   // are lines waiting for room to answer?
+    int searching;                  // searches that will answer the client
+    bool overflowed;                // did an answer not fit? Then the
+                                    // client is disconnected
+    size_t inLength;
+    size_t outLength;
+    char in[SERVER_LINE_SIZE];      // lines read but not yet carried out
+    char out[SERVER_OUTPUT_SIZE];   // answers the socket has not taken
+}
+ServerClient;
+
+
+/* State of the server, shared with the worker threads */
+typedef struct
+{
+    Engine *engine;
+    ServerGame *games;
+    int gameSlots;
+    int gameCount;                  // number of games being played
+    int freeGame;                   // first free game slot, or -1
+    ServerClient *clients;
+    int clientCount;                // number of connected clients
+    int freeClient;                 // first free client slot, or -1
+    int epoll;
+    int listener;                   // the listening socket
+    int wake;                       // eventfd the workers signal
+    int searches;                   // games queued or being searched
+    pthread_mutex_t lock;           // guards the queues and stopping
+    pthread_cond_t searchQueued;    // signalled when a search is queued
+    int pending[SERVER_QUEUE_SIZE]; // games waiting for a worker
+    unsigned int pendingHead;
+    unsigned int pendingTail;
+    int finished[SERVER_QUEUE_SIZE]; // games searched, to be answered
+    unsigned int finishedHead;
+    unsigned int finishedTail;
+    bool stopping;                  // should the workers leave?
+    double latencies[SERVER_LATENCIES]; // seconds to answer recent searches
+    unsigned long long moves;       // searches answered
+}
+Server;
+
+
+/* Set by the signal handler to stop the server */
+static volatile sig_atomic_t stopRequested = 0;
+
+
+/*
+ * Ask the server to stop, from a signal.
+ *
+ * params:
+ * signal: the signal number
+ */
+static void requestStop(int signal)
+{
+    (void)signal;
+    stopRequested = 1;
+}
+
+
+/*
+ * Queue an answer line for a client. A client whose answers no longer fit
+ * in its buffer has stopped reading them, and is disconnected.
+ *
+ * params:
+ * client: the client
+ * format: printf() format of the line, without the line ending
+ * ...: the values of the format
+ */
+static void respond(ServerClient *client, const char *format, ...)
+{
+    size_t room = sizeof(client->out) - client->outLength;
+    va_list args;
+    int length = 0;
+
+    if (client->fd < 0 || client->overflowed)
+    {
+        return;
+    }
+
+    va_start(args, format);
+    length = vsnprintf(client->out + client->outLength, room, format, args);
+    va_end(args);
+
+    if (length < 0 || (size_t)length + 1 >= room)
+    {
+        client->overflowed = true;
+        return;
+    }
+
+    client->outLength += length;
+    client->out[client->outLength++] = '\n';
+}
+
+
+/*
+ * Disconnect a client and free its slot. Searches it asked for are still
+ * played in their games, but nobody is told.
+ *
+ * params:
+ * server: the server
+ * slot: the client's slot
+ */
+static void closeClient(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+
+    epoll_ctl(server->epoll, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    client->generation++;
+    client->nextFree = server->freeClient;
+    server->freeClient = slot;
+    server->clientCount--;
+}
+
+
+/*
+ * Send a client as much of its answers as its socket takes. A client whose
+ * answers overflowed, or whose socket failed, is disconnected.
+ *
+ * params:
+ * server: the server
+ * slot: the client's slot
+ *
+ * returns:
+ * the number of bytes sent, or -1 if the client is disconnected
+ */
+static ssize_t sendAnswers(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+    size_t sent = 0;
+    ssize_t count = 0;
+
+    if (client->fd < 0)
+    {
+        return -1;
+    }
+
+    if (client->overflowed)
+    {
+        closeClient(server, slot);
+        return -1;
+    }
+
+    while (sent < client->outLength)
+    {
+        count = send(client->fd, client->out + sent, client->outLength - sent,
+                MSG_NOSIGNAL);
+
+        if (count <= 0)
+        {
+            break;
+        }
+
+        sent += count;
+    }
+
+    if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        closeClient(server, slot);
+        return -1;
+    }
+
+    memmove(client->out, client->out + sent, client->outLength - sent);
+    client->outLength -= sent;
+
+    return sent;
+}
+
+
+/*
+ * Send a client as much of its answers as its socket takes, and choose the
+ * events to wait for: room in the socket if answers are left, and more
+ * commands unless the client is stalled. A stalled client with every answer
+ * sent waits for its searches, which serve it again as they end.
+ *
+ * params:
+ * server: the server
+ * slot: the client's slot
+ */
+static void flushClient(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+    struct epoll_event event;
+
+    if (sendAnswers(server, slot) < 0)
+    {
+        return;
+    }
+
+    event.events = (client->stalled ? 0 : EPOLLIN)
+            | (client->outLength > 0 ? EPOLLOUT : 0);
+    event.data.u64 = slot;
+    epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+
+/*
+ * Get the id of a game.
+ *
+ * params:
+ * server: the server
+ * game: the game
+ *
+ * returns:
+ * the game id
+ */
+static unsigned long gameId(const Server *server, const ServerGame *game)
+{
+    return (unsigned long)game->generation * server->gameSlots
+            + (unsigned long)(game - server->games);
+}
+
+
+/*
+ * Find the game a command names, if it is searching or not as the command
+ * needs.
+ *
+ * params:
+ * server: the server
+ * word: the game id, or NULL if the command has none
+ * client: the client, who is told if there is no such game
+ * searching: must the game be searching, rather than waiting for commands?
+ *
+ * returns:
+ * the game, or NULL if there is no such game or it is not in the state
+ * asked for
+ */
+static ServerGame *findGame(Server *server, const char *word,
+        ServerClient *client, bool searching)
+{
+    ServerGame *game = NULL;
+    long int id = 0;
+
+    if (word != NULL && parseInt(word, &id) && id >= 0)
+    {
+        game = &server->games[id % server->gameSlots];
+
+        if (!game->used || game->generation != id / server->gameSlots)
+        {
+            game = NULL;
+        }
+    }
+
+    if (game == NULL)
+    {
+        respond(client, "error no game %.*s", SERVER_ECHO_SIZE,
+                word != NULL ? word : "given");
+    }
+    else if (game->busy != searching)
+    {
+        respond(client, "error game %lu is %ssearching", gameId(server, game),
+                searching ? "not " : "");
+        game = NULL;
+    }
+
+    return game;
+}
+
+
+/*
+ * Play a move in a game, which must not be over.
+ *
+ * params:
+ * game: the game
+ * col: the column, which must have room
+ *
+ * returns:
+ * " won" if the move won the game, " drawn" if it filled the board, or ""
+ */
+static const char *playGameMove(ServerGame *game, int col)
+{
+    bool won = false;
+
+    game->moves[game->pos.moves] = '1' + col;
+    won = placePiece(&game->pos, col);
+    game->over = won || isBoardFull(&game->pos);
+
+    return won ? " won" : game->over ? " drawn" : "";
+}
+
+
+/*
+ * Carry out a new command: start a game in a free slot.
+ *
+ * params:
+ * server: the server
+ * client: the client
+ * moves: the moves of the game so far, or NULL for none
+ */
+static void newGame(Server *server, ServerClient *client, const char *moves)
+{
+    ServerGame *game = NULL;
+    Position pos;
+    int slot = server->freeGame;
+
+    initPosition(&pos);
+
+    if (moves != NULL && !playMoves(&pos, moves))
+    {
+        respond(client, "error invalid moves %.*s", SERVER_ECHO_SIZE, moves);
+        return;
+    }
+
+    if (slot < 0)
+    {
+        respond(client, "error no room for another game");
+        return;
+    }
+
+    /* playMoves() never ends a game, so the game is not over */
+    game = &server->games[slot];
+    server->freeGame = game->nextFree;
+    server->gameCount++;
+    game->pos = pos;
+    memset(game->moves, 0, sizeof(game->moves));
+    strcpy(game->moves, moves != NULL ? moves : "");
+    game->used = true;
+    game->busy = false;
+    game->over = false;
+
+    respond(client, "game %lu", gameId(server, game));
+}
+
+
+/*
+ * Carry out an end command: free the slot of a game.
+ *
+ * params:
+ * server: the server
+ * game: the game
+ */
+static void endGame(Server *server, ServerGame *game)
+{
+    game->used = false;
+    game->generation++;
+    game->nextFree = server->freeGame;
+    server->freeGame = game - server->games;
+    server->gameCount--;
+}
+
+
+/*
+ * Carry out a play command.
+ *
+ * params:
+ * server: the server
+ * client: the client
+ * args: the rest of the command line, split by strtok_r()
+ */
+static void playCommand(Server *server, ServerClient *client, char *args)
+{
+    ServerGame *game = findGame(server, strtok_r(NULL, " \t", &args), client,
+            false);
+    const char *word = strtok_r(NULL, " \t", &args);
+    long int col = 0;
+
+    if (game == NULL)
+    {
+        return;
+    }
+
+    if (game->over)
+    {
+        respond(client, "error game %lu is over", gameId(server, game));
+    }
+    else if (word == NULL || !parseInt(word, &col) || col < 1 || col > COLS
+            || !canPlay(&game->pos, col - 1))
+    {
+        respond(client, "error invalid move %.*s", SERVER_ECHO_SIZE,
+                word != NULL ? word : "");
+    }
+    else
+    {
+        respond(client, "played %lu %ld%s", gameId(server, game), col,
+                playGameMove(game, col - 1));
+    }
+}
+
+
+/*
+ * Carry out a go command: answer from the book, or queue a search.
+ *
+ * params:
+ * server: the server
+ * client: the client
+ * args: the rest of the command line, split by strtok_r()
+ */
+static void goCommand(Server *server, ServerClient *client, char *args)
+{
+    ServerGame *game = findGame(server, strtok_r(NULL, " \t", &args), client,
+            false);
+    int depth = server->engine->limits.depth;
+    int timeLimit = server->engine->limits.timeLimit;
+    char *word = NULL;
+    char *value = NULL;
+    long int number = 0;
+    int move = 0;
+    int score = 0;
+
+    if (game == NULL)
+    {
+        return;
+    }
+
+    for (word = strtok_r(NULL, " \t", &args); word != NULL;
+            word = strtok_r(NULL, " \t", &args))
+    {
+        value = strtok_r(NULL, " \t", &args);
+
+        if (value == NULL || !parseInt(value, &number) || number < 1
+                || (strcmp(word, "depth") == 0 && number > CELLS)
+                || (strcmp(word, "time") == 0 && number > MAX_SERVER_TIME))
+        {
+            respond(client, "error invalid %.*s", SERVER_ECHO_SIZE, word);
+            return;
+        }
+
+        if (strcmp(word, "depth") == 0)
+        {
+            depth = number;
+        }
+        else if (strcmp(word, "time") == 0)
+        {
+            timeLimit = number;
+            depth = 0;
+        }
+        else
+        {
+            respond(client, "error unknown go option %.*s",
+                    SERVER_ECHO_SIZE, word);
+            return;
+        }
+    }
+
+    if (game->over)
+    {
+        respond(client, "error game %lu is over", gameId(server, game));
+    }
+    else if (bookLookup(&server->engine->book, &game->pos, &move, &score))
+    {
+        respond(client, "move %lu %d score %d book%s", gameId(server, game),
+                move + 1, score, playGameMove(game, move));
+    }
+    else if (server->searches == SERVER_QUEUE_SIZE)
+    {
+        respond(client, "error too many searches");
+    }
+    else
+    {
+        /* A depth alone could keep a worker for minutes */
+        if (timeLimit == 0)
+        {
+            timeLimit = THINK_TIME;
+        }
+
+        game->busy = true;
+        atomic_store(&game->stop, false);
+        game->client = client - server->clients;
+        game->clientGeneration = client->generation;
+        client->searching++;
+        game->depth = depth;
+        game->timeLimit = timeLimit < MAX_SERVER_TIME ? timeLimit
+                : MAX_SERVER_TIME;
+        game->queued = getTime();
+        server->searches++;
+
+        pthread_mutex_lock(&server->lock);
+        server->pending[server->pendingTail++ % SERVER_QUEUE_SIZE] =
+                game - server->games;
+        pthread_cond_signal(&server->searchQueued);
+        pthread_mutex_unlock(&server->lock);
+    }
+}
+
+
+/*
+ * Order two latencies, for qsort().
+ *
+ * params:
+ * a: the first latency
+ * b: the second latency
+ *
+ * returns:
+ * a negative number, zero or a positive number if the first latency is
+ * less than, equal to or greater than the second
+ */
+static int compareLatencies(const void *a, const void *b)
+{
+    double first = *(const double *)a;
+    double second = *(const double *)b;
+
+    return (first > second) - (first < second);
+}
+
+
+/*
+ * Carry out a stats command.
+ *
+ * params:
+ * server: the server
+ * client: the client
+ */
+static void statsCommand(Server *server, ServerClient *client)
+{
+    double sorted[SERVER_LATENCIES];
+    size_t count = server->moves < SERVER_LATENCIES ? server->moves
+            : SERVER_LATENCIES;
+
+    memcpy(sorted, server->latencies, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), compareLatencies);
+
+    respond(client, "stats games %d clients %d searches %d moves %llu "
+            "p50 %.0f p99 %.0f", server->gameCount, server->clientCount,
+            server->searches, server->moves,
+            count > 0 ? 1000 * sorted[count / 2] : 0.0,
+            count > 0 ? 1000 * sorted[count * 99 / 100] : 0.0);
+}
+
+
+/*
+ * Carry out one command line of a client.
+ *
+ * params:
+ * server: the server
+ * client: the client
+ * line: the line, without its line ending
+ */
+static void runCommand(Server *server, ServerClient *client, char *line)
+{
+    ServerGame *game = NULL;
+    char *rest = NULL;
+    char *command = strtok_r(line, " \t\r", &rest);
+
+    if (command == NULL)
+    {
+        return;                     // blank line
+    }
+
+    if (strcmp(command, "new") == 0)
+    {
+        newGame(server, client, strtok_r(NULL, " \t\r", &rest));
+    }
+    else if (strcmp(command, "play") == 0)
+    {
+        playCommand(server, client, rest);
+    }
+    else if (strcmp(command, "go") == 0)
+    {
+        goCommand(server, client, rest);
+    }
+    else if (strcmp(command, "show") == 0
+            && (game = findGame(server, strtok_r(NULL, " \t\r", &rest),
+                client, false)) != NULL)
+    {
+        respond(client, "position %lu %s", gameId(server, game), game->moves);
+    }
+    else if (strcmp(command, "end") == 0
+            && (game = findGame(server, strtok_r(NULL, " \t\r", &rest),
+                client, false)) != NULL)
+    {
+        respond(client, "ended %lu", gameId(server, game));
+        endGame(server, game);
+    }
+    else if (strcmp(command, "stop") == 0
+            && (game = findGame(server, strtok_r(NULL, " \t\r", &rest),
+                client, true)) != NULL)
+    {
+        atomic_store(&game->stop, true);
+    }
+    else if (strcmp(command, "stats") == 0)
+    {
+        statsCommand(server, client);
+    }
+    else if (strcmp(command, "show") != 0 && strcmp(command, "end") != 0
+            && strcmp(command, "stop") != 0)
+    {
+        respond(client, "error unknown command %.*s", SERVER_ECHO_SIZE,
+                command);
+    }
+}
+
+
+/*
+ * Carry out the whole lines a client has sent, for as long as there is room
+ * for their answers, and for those of the client's searches. If there is
+ * not, the client is stalled until its answers have been sent or its
+ * searches have ended.
+ *
+ * params:
+ * server: the server
+ * client: the client
+ */
+static void runLines(Server *server, ServerClient *client)
+{
+    char *start = client->in;
+    char *end = NULL;
+
+    client->stalled = false;
+
+    while ((end = memchr(start, '\n', client->inLength - (start - client->in)))
+            != NULL)
+    {
+        if (sizeof(client->out) - client->outLength
+                < (size_t)SERVER_ANSWER_SIZE * (client->searching + 1))
+        {
+            client->stalled = true;
+            break;
+        }
+
+        *end = '\0';
+
+        if (!client->discarding)
+        {
+            runCommand(server, client, start);
+        }
+
+        client->discarding = false;
+        start = end + 1;
+    }
+
+    client->inLength -= start - client->in;
+    memmove(client->in, start, client->inLength);
+}
+
+
+/*
+ * Carry out what a client has sent, read more while it is not stalled, and
+ * send it the answers.
+ *
+ * params:
+ * server: the server
+ * slot: the client's slot
+ */
+static void serveClient(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+    ssize_t count = 0;
+
+    while (client->fd >= 0)
+    {
+        runLines(server, client);
+
+        /* Sending answers may make room to carry out more lines */
+        if (client->stalled)
+        {
+            count = sendAnswers(server, slot);
+
+            if (count < 0)
+            {
+                return;
+            }
+
+            if (count == 0)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        if (client->inLength == sizeof(client->in))
+        {
+            if (!client->discarding)
+            {
+                respond(client, "error line too long");
+            }
+
+            client->discarding = true;
+            client->inLength = 0;
+        }
+
+        count = recv(client->fd, client->in + client->inLength,
+                sizeof(client->in) - client->inLength, 0);
+
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK
+                || errno == EINTR))
+        {
+            break;                  // everything sent so far has been read
+        }
+
+        if (count <= 0)
+        {
+            closeClient(server, slot);
+            return;
+        }
+
+        client->inLength += count;
+    }
+
+    flushClient(server, slot);
+}
+
+
+/*
+ * Accept every waiting connection. Connections beyond SERVER_CLIENTS are
+ * closed at once.
+ *
+ * params:
+ * server: the server
+ */
+static void acceptClients(Server *server)
+{
+    ServerClient *client = NULL;
+    struct epoll_event event;
+    int slot = 0;
+    int fd = 0;
+
+    while ((fd = accept(server->listener, NULL, NULL)) >= 0)
+    {
+        slot = server->freeClient;
+        event.events = EPOLLIN;
+        event.data.u64 = slot;
+
+        if (slot < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0
+                || fcntl(fd, F_SETFD, FD_CLOEXEC) != 0
+                || epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        client = &server->clients[slot];
+        server->freeClient = client->nextFree;
+        server->clientCount++;
+        client->fd = fd;
+        client->discarding = false;
+        client->stalled = false;
+        client->overflowed = false;
+        client->searching = 0;
+        client->inLength = 0;
+        client->outLength = 0;
+    }
+}
+
+
+/*
+ * Play and answer the moves of every search the workers have finished.
+ *
+ * params:
+ * server: the server
+ */
+static void finishSearches(Server *server)
+{
+    ServerGame *game = NULL;
+    ServerClient *client = NULL;
+    uint64_t wakeups = 0;
+    const char *ending = NULL;
+    double seconds = 0;
+    int slot = 0;
+
+    if (read(server->wake, &wakeups, sizeof(wakeups)) < 0)
+    {
+        return;                     // the searches were answered already
+    }
+
+    pthread_mutex_lock(&server->lock);
+
+    while (server->finishedHead != server->finishedTail)
+    {
+        slot = server->finished[server->finishedHead++ % SERVER_QUEUE_SIZE];
+        pthread_mutex_unlock(&server->lock);
+
+        game = &server->games[slot];
+        client = &server->clients[game->client];
+        ending = playGameMove(game, game->bestMove);
+        seconds = getTime() - game->queued;
+        game->busy = false;
+        server->searches--;
+        server->latencies[server->moves++ % SERVER_LATENCIES] = seconds;
+
+        if (client->fd >= 0 && client->generation == game->clientGeneration)
+        {
+            client->searching--;
+            respond(client, "move %lu %d score %d depth %d nodes %llu "
+                    "time %.0f%s", gameId(server, game), game->bestMove + 1,
+                    game->score, game->reached, game->nodes, 1000 * seconds,
+                    ending);
+
+            /* Lines waiting for the search to end can now be carried out */
+            serveClient(server, game->client);
+        }
+
+        pthread_mutex_lock(&server->lock);
+    }
+
+    pthread_mutex_unlock(&server->lock);
+}
+
+
+/*
+ * Search queued games until the server stops.
+ *
+ * params:
+ * arg: the Server
+ *
+ * returns:
+ * NULL
+ */
+static void *searchGames(void *arg)
+{
+    Server *server = (Server *)arg;
+    SearchLimits limits = server->engine->limits;
+    SearchResult result;
+    ServerGame *game = NULL;
+    Position pos;
+    const uint64_t wakeup = 1;
+    int waited = 0;                 // ms the search spent in the queue
+    int slot = 0;
+
+    limits.threads = 1;
+
+    pthread_mutex_lock(&server->lock);
+
+    while (true)
+    {
+        while (server->pendingHead == server->pendingTail
+                && !server->stopping)
+        {
+            pthread_cond_wait(&server->searchQueued, &server->lock);
+        }
+
+        if (server->stopping)
+        {
+            break;
+        }
+
+        /* The serving thread leaves a busy game alone */
+        slot = server->pending[server->pendingHead++ % SERVER_QUEUE_SIZE];
+        game = &server->games[slot];
+        pthread_mutex_unlock(&server->lock);
+
+        pos = game->pos;
+        limits.stop = &game->stop;
+        limits.depth = game->depth;
+        limits.timeLimit = game->timeLimit;
+        waited = (int)(1000 * (getTime() - game->queued));
+
+        if (limits.timeLimit > 0)
+        {
+            limits.timeLimit = waited < limits.timeLimit
+                    ? limits.timeLimit - waited : 1;
+        }
+
+        searchPosition(&pos, &limits, &server->engine->tt, &result);
+        game->bestMove = result.bestMove;
+        game->score = result.score;
+        game->reached = result.depth;
+        game->nodes = result.nodes;
+
+        pthread_mutex_lock(&server->lock);
+        server->finished[server->finishedTail++ % SERVER_QUEUE_SIZE] = slot;
+
+        if (write(server->wake, &wakeup, sizeof(wakeup)) < 0)
+        {
+            perror("eventfd");
+        }
+    }
+
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+
+/*
+ * Open the listening socket, replacing any file already at the path.
+ *
+ * params:
+ * path: the path of the socket
+ *
+ * returns:
+ * the socket, or -1 if it could not be opened
+ */
+static int openListener(const char *path)
+{
+    struct sockaddr_un address;
+    int fd = -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return -1;
+    }
+
+    strcpy(address.sun_path, path);
+    unlink(path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0
+            || listen(fd, SOMAXCONN) != 0)
+    {
+        perror(path);
+
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+
+        return -1;
+    }
+
+    return fd;
+}
+
+
+/*
+ * Wait for events and serve them until the server is asked to stop. The
+ * stop signals must be blocked, and are only let through while waiting, so
+ * one that comes between a check of stopRequested and the wait still ends
+ * the wait.
+ *
+ * params:
+ * server: the server
+ * waitMask: the signal mask to wait with, which lets the stop signals in
+ */
+static void serveEvents(Server *server, const sigset_t *waitMask)
+{
+    struct epoll_event events[SERVER_EVENTS];
+    int count = 0;
+    int i = 0;
+
+    while (!stopRequested)
+    {
+        count = epoll_pwait(server->epoll, events, SERVER_EVENTS, -1,
+                waitMask);
+
+        for (i = 0; i < count; i++)
+        {
+            if (events[i].data.u64 == LISTENER_EVENT)
+            {
+                acceptClients(server);
+            }
+            else if (events[i].data.u64 == WAKE_EVENT)
+            {
+                finishSearches(server);
+            }
+            else
+            {
+                /* Sending first makes room to carry out stalled lines */
+                flushClient(server, events[i].data.u64);
+                serveClient(server, events[i].data.u64);
+            }
+        }
+    }
+}
+
+
+/*
+ * Serve games to clients on a Unix socket until interrupted.
+ *
+ * params:
+ * path: the path of the socket
+ * engine: the computer player whose limits, table and book are used
+ * gameSlots: the most games that can be played at once
+ * threads: number of search worker threads
+ *
+ * returns:
+ * true if the server ran, false if it could not be started
+ */
+bool runServer(const char *path, Engine *engine, int gameSlots, int threads)
+{
+    Server *server = (Server *)calloc(1, sizeof(Server));
+    pthread_t *workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    struct epoll_event event;
+    struct sigaction action;
+    sigset_t stopSignals;
+    sigset_t previousMask;
+    sigset_t waitMask;
+    int started = 0;
+    int i = 0;
+    bool ready = server != NULL && workers != NULL;
+
+    /* Blocked here and so in the workers, which inherit the mask: only the
+       serving thread takes the stop signals, and only while it waits */
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask);
+    waitMask = previousMask;
+    sigdelset(&waitMask, SIGINT);
+    sigdelset(&waitMask, SIGTERM);
+
+    if (ready)
+    {
+        server->engine = engine;
+        server->gameSlots = gameSlots;
+        server->games = (ServerGame *)calloc(gameSlots, sizeof(ServerGame));
+        server->clients = (ServerClient *)calloc(SERVER_CLIENTS,
+                sizeof(ServerClient));
+        server->listener = -1;
+        server->epoll = -1;
+        server->wake = -1;
+        ready = server->games != NULL && server->clients != NULL;
+    }
+
+    if (ready)
+    {
+        server->freeGame = -1;
+        server->freeClient = -1;
+
+        for (i = gameSlots - 1; i >= 0; i--)
+        {
+            server->games[i].nextFree = server->freeGame;
+            atomic_init(&server->games[i].stop, false);
+            server->freeGame = i;
+        }
+
+        for (i = SERVER_CLIENTS - 1; i >= 0; i--)
+        {
+            server->clients[i].fd = -1;
+            server->clients[i].nextFree = server->freeClient;
+            server->freeClient = i;
+        }
+
+        server->listener = openListener(path);
+        server->epoll = epoll_create1(EPOLL_CLOEXEC);
+        server->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ready = server->listener >= 0 && server->epoll >= 0
+                && server->wake >= 0;
+    }
+
+    if (ready)
+    {
+        event.events = EPOLLIN;
+        event.data.u64 = LISTENER_EVENT;
+        ready = epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->listener,
+                &event) == 0;
+        event.data.u64 = WAKE_EVENT;
+        ready = ready && epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->wake,
+                &event) == 0;
+    }
+
+    if (ready)
+    {
+        pthread_mutex_init(&server->lock, NULL);
+        pthread_cond_init(&server->searchQueued, NULL);
+
+        for (i = 0; i < threads; i++)
+        {
+            if (pthread_create(&workers[started], NULL, searchGames,
+                    server) == 0)
+            {
+                started++;
+            }
+        }
+
+        ready = started > 0;
+    }
+
+    if (ready)
+    {
+        /* Without SA_RESTART, so a signal ends the wait for events */
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = requestStop;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+
+        fprintf(stderr, "Serving up to %d games on %s with %d search "
+                "threads\n", gameSlots, path, started);
+        serveEvents(server, &waitMask);
+    }
+    else
+    {
+        fprintf(stderr, "Could not start the server\n");
+    }
+
+    if (started > 0)
+    {
+        pthread_mutex_lock(&server->lock);
+        server->stopping = true;
+        pthread_cond_broadcast(&server->searchQueued);
+        pthread_mutex_unlock(&server->lock);
+
+        /* End the running searches; the queued ones are never started */
+        for (i = 0; i < gameSlots; i++)
+        {
+            if (server->games[i].busy)
+            {
+                atomic_store(&server->games[i].stop, true);
+            }
+        }
+
+        for (i = 0; i < started; i++)
+        {
+            pthread_join(workers[i], NULL);
+        }
+
+        pthread_cond_destroy(&server->searchQueued);
+        pthread_mutex_destroy(&server->lock);
+        fprintf(stderr, "Answered %llu searches\n", server->moves);
+    }
+
+    for (i = 0; server != NULL && server->clients != NULL
+            && i < SERVER_CLIENTS; i++)
+    {
+        if (server->clients[i].fd >= 0)
+        {
+            close(server->clients[i].fd);
+        }
+    }
+
+    if (server != NULL && server->listener >= 0)
+    {
+        close(server->listener);
+        unlink(path);
+    }
+
+    if (server != NULL && server->epoll >= 0)
+    {
+        close(server->epoll);
+    }
+
+    if (server != NULL && server->wake >= 0)
+    {
+        close(server->wake);
+    }
+
+    if (server != NULL)
+    {
+        free(server->clients);
+        free(server->games);
+    }
+
+    free(server);
+    free(workers);
+    pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+
+    return ready;
+}
@@ -0,0 +1,823 @@
+/*
+ * Exact solving of positions, one at a time or streamed in batches.
+ *
+ * A position is solved by searching it to the end of the game, so its score
+ * is its game-theoretic value with perfect play. Solved scores are reported
+ * counting stones instead of moves: a win scores the number of stones the
+ * winner has left to play after their winning move, plus one, and a loss the
+ * same for the opponent, negated. So a win with the last stone of the game
+ * scores 1, and a draw scores 0.
+ *
+ * A position can also be solved with null-window searches, each of which
+ * only tells whether the score is above or below a guess but prunes far
+ * more than a search with the full window. The guesses halve the range the
+ * score can still be in, until only the exact score is left; guesses lean
+ * towards a draw, since most positions are worth about that.
+ *
+ * The weak solver only finds whether a position is won, drawn or lost. It
+ * searches with the window [-1, 1] on outcomes of 1, 0 and -1, so how soon
+ * a game is won makes no difference, a win anywhere cuts off its siblings,
+ * and far fewer positions are searched. Its results are stored in a table
+ * of its own, whose entries take one word instead of two. On the positions
+ * of benchmarkWeak() it solves about three times faster than the strong
+ * solver: 1.7 s against 5.1 s on one core.
+ *
+ * The batch solver reads one position per line, as a string of columns
+ * starting at 1 (for example "4453"), and writes a line with the moves, the
+ * score and the best column for each. A line may end with the way to solve
+ * its position, "strong", "exact" or "weak", after a space; otherwise the
+ * batch's own way is used. Lines are solved by a pool of worker threads
+ * sharing one transposition table, while the main thread reads the
+ * input ahead into a ring of SOLVE_QUEUE_SIZE slots and writes the results
+ * in input order as they complete. At most that many lines are in memory at
+ * once, however long the input.
+ */
+
+
+#include "c4.h"
+
+
+/* A line of the batch solver's input and its result */
+typedef struct
+{
+    char line[SOLVE_LINE_SIZE];     // the moves, then the way to solve
+    int mode;                       // how the position is solved
+    bool valid;                     // is the line a position to solve?
+    bool done;                      // has the line been solved?
+    SearchResult result;
+}
+SolveSlot;
+
+
+/* State shared by the batch solver threads */
+typedef struct
+{
+    SolveSlot *slots;               // ring of SOLVE_QUEUE_SIZE lines
+    unsigned long head;             // number of lines read
+    unsigned long next;             // number of lines handed to workers
+    bool endOfInput;
+    pthread_mutex_t lock;           // guards every field above
+    pthread_cond_t linesRead;       // signalled when lines are read
+    pthread_cond_t lineSolved;      // signalled when a line is solved
+    TranspositionTable *tt;
+    WeakTable *weak;                // table of the weak solver
+    int mode;                       // how lines that do not say are solved
+}
+BatchSolver;
+
+
+/* Names of the ways to solve a line, by enum solveMode */
+static const char *solveModeNames[] = {"strong", "exact", "weak"};
+
+
+/* Positions solved by benchmarkWeak(), as moves from the start */
+static const char *benchWeakPositions[] =
+{
+    "26121347245152",
+    "16243277427712",
+    "61155412653734",
+    "26741243217432",
+    "42147526473214",
+    "63362571457336",
+    "74372776433525",
+    "12254562276266"
+};
+
+
+/*
+ * Convert a search score to a solved score, which counts the stones the
+ * winner has left after their winning move instead of the moves played.
+ *
+ * params:
+ * score: the exact score of a position, from a search to the end of the game
+ *
+ * returns:
+ * the solved score
+ */
+int solvedScore(int score)
+{
+    int solved = 0;
+
+    if (score > 0)
+    {
+        solved = (CELLS + 2 - (WIN_SCORE - score)) / 2;
+    }
+    else if (score < 0)
+    {
+        solved = -(CELLS + 2 - (WIN_SCORE + score)) / 2;
+    }
+
+    return solved;
+}
+
+
+/*
+ * Find the exact score and best move of a position by searching it to the
+ * end of the game. The board must not be full.
+ *
+ * params:
+ * pos: the position to solve, restored before returning
+ * tt: the transposition table to use
+ * result: where the best move, its exact score and the statistics are stored
+ */
+void solvePosition(Position *pos, TranspositionTable *tt, SearchResult *result)
+{
+    SearchContext ctx;
+    double startTime = getTime();
+
+    memset(result, 0, sizeof(*result));
+    result->bestMove = -1;
+    initSearchContext(&ctx, tt, result);
+    result->nodes = 1;
+
+    searchRoot(pos, CELLS - pos->moves, &ctx);
+
+    result->seconds = getTime() - startTime;
+}
+
+
+/*
+ * Search every move of a position with a null window around a guess, to find
+ * whether the score of the position is above it. The board must not be
+ * full.
+ *
+ * params:
+ * pos: the position to search, restored before returning
+ * guess: the score the null window is above
+ * ctx: the transposition table and statistics of the search
+ * bestMove: the move searched first; if the score is above the guess, the
+ *           move that scores above it is stored here
+ *
+ * returns:
+ * a score above the guess that some move is worth at least, or a score of
+ * at most the guess that no move is worth more than
+ */
+static int testScore(Position *pos, int guess, SearchContext *ctx,
+        int *bestMove)
+{
+    int moves[COLS];
+    int moveCount = orderMoves(pos, ctx, *bestMove, moves);
+    int bestScore = -WIN_SCORE;
+    int score = 0;
+    int col = 0;
+    int i = 0;
+
+    for (i = 0; i < moveCount && bestScore <= guess; i++)
+    {
+        col = moves[i];
+
+        if (isWinningMove(pos, col))
+        {
+            score = WIN_SCORE - (int)pos->moves - 1;
+        }
+        else
+        {
+            playMove(pos, col);
+            score = -negamax(pos, CELLS - pos->moves, -(guess + 1), -guess,
+                    ctx);
+            undoMove(pos, col);
+        }
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+
+            if (score > guess)
+            {
+                *bestMove = col;
+            }
+        }
+    }
+
+    return bestScore;
+}
+
+
+/*
+ * Find the exact score and best move of a position with null-window searches
+ * to the end of the game. The board must not be full. The number of
+ * searches it took is stored in the result.
+ *
+ * A solve that passes the time limit of the limits, or is stopped by their
+ * stop flag, ends without a move. Their depth and threads are not used.
+ *
+ * params:
+ * pos: the position to solve, restored before returning
+ * limits: the time limit, stop flag and tablebase, or NULL for none
+ * tt: the transposition table to use
+ * result: where the best move, its exact score and the statistics are stored
+ *
+ * returns:
+ * true if the position was solved, false if the solve ran out of time or
+ * was stopped
+ */
+bool solveNullWindow(Position *pos, const SearchLimits *limits,
+        TranspositionTable *tt, SearchResult *result)
+{
+    SearchContext ctx;
+    double startTime = getTime();
+    int low = -(WIN_SCORE - (int)pos->moves - 2);   // lose to the next move
+    int high = WIN_SCORE - (int)pos->moves - 1;     // win with this move
+    int guess = 0;
+    int score = 0;
+    int move = -1;
+    bool moveFound = false;         // is move known to score the low bound?
+
+    memset(result, 0, sizeof(*result));
+    result->bestMove = -1;
+    initSearchContext(&ctx, tt, result);
+    result->nodes = 1;
+
+    if (limits != NULL)
+    {
+        ctx.stop = limits->stop;
+        ctx.tablebase = limits->tablebase;
+
+        if (limits->timeLimit > 0)
+        {
+            ctx.deadline = startTime + limits->timeLimit / 1000.0;
+        }
+    }
+
+    while ((low < high || !moveFound) && !ctx.aborted)
+    {
+        if (low < high)
+        {
+            guess = low + (high - low) / 2;
+
+            if (guess <= 0 && low / 2 < guess)
+            {
+                guess = low / 2;
+            }
+            else if (guess >= 0 && high / 2 > guess)
+            {
+                guess = high / 2;
+            }
+        }
+        else
+        {
+            guess = low - 1;        // only to find a move worth the score
+        }
+
+        score = testScore(pos, guess, &ctx, &move);
+        result->researches++;
+
+        if (ctx.aborted)
+        {
+            break;                  // the score of the search is not known
+        }
+
+        if (score > guess)
+        {
+            low = score;
+            moveFound = true;
+        }
+        else
+        {
+            high = score;
+        }
+    }
+
+    result->seconds = getTime() - startTime;
+
+    if (ctx.aborted)
+    {
+        return false;
+    }
+
+    result->bestMove = move;
+    result->score = low;
+    result->depth = CELLS - pos->moves;
+
+    return true;
+}
+
+
+/*
+ * Find whether a position is won, drawn or lost for the player to move with
+ * perfect play, by a search to the end of the game on outcomes instead of
+ * scores.
+ *
+ * The returned outcome is exact if it lies strictly between alpha and beta,
+ * and a bound otherwise, as for negamax().
+ *
+ * params:
+ * pos: the position to solve, restored before returning
+ * alpha: outcome the player to move is already guaranteed
+ * beta: outcome the opponent is already guaranteed, negated
+ * table: the table of solved positions
+ * ctx: the killer moves, history and statistics of the search
+ *
+ * returns:
+ * 1 if the position is won, 0 if it is drawn, -1 if it is lost
+ */
+static int weakNegamax(Position *pos, int alpha, int beta, WeakTable *table,
+        SearchContext *ctx)
+{
+    uint64_t key = 0;
+    bool mirrored = false;          // is the key of the mirror image?
+    int moves[COLS];
+    int moveCount = 0;
+    int originalAlpha = alpha;
+    int bestOutcome = -2;           // below every outcome
+    int bestMove = -1;
+    int firstMove = -1;
+    int outcome = 0;
+    int bound = BOUND_NONE;
+    int col = 0;
+    int i = 0;
+
+    ctx->result->nodes++;
+
+    if (isBoardFull(pos))
+    {
+        return 0;
+    }
+
+    for (col = 0; col < COLS; col++)
+    {
+        if (canPlay(pos, col) && isWinningMove(pos, col))
+        {
+            return 1;
+        }
+    }
+
+    key = canonicalKey(pos, &mirrored);
+
+    if (weakTableProbe(table, key, &outcome, &bound, &firstMove, ctx->result))
+    {
+        if (bound == BOUND_EXACT
+                || (bound == BOUND_LOWER && outcome >= beta)
+                || (bound == BOUND_UPPER && outcome <= alpha))
+        {
+            return outcome;
+        }
+
+        if (mirrored && firstMove >= 0)
+        {
+            firstMove = MIRROR_COLUMN(firstMove);
+        }
+    }
+
+    moveCount = orderMoves(pos, ctx, firstMove, moves);
+
+    for (i = 0; i < moveCount && alpha < beta; i++)
+    {
+        col = moves[i];
+
+        playMove(pos, col);
+        outcome = -weakNegamax(pos, -beta, -alpha, table, ctx);
+        undoMove(pos, col);
+
+        if (outcome > bestOutcome)
+        {
+            bestOutcome = outcome;
+            bestMove = col;
+
+            if (outcome > alpha)
+            {
+                alpha = outcome;
+            }
+        }
+    }
+
+    if (bestOutcome >= beta)
+    {
+        ctx->result->cutoffs++;
+        ctx->result->firstCutoffs += (i == 1);
+        recordCutoff(pos, ctx, bestMove, CELLS - pos->moves);
+    }
+
+    if (mirrored)
+    {
+        bestMove = MIRROR_COLUMN(bestMove);
+    }
+
+    if (bestOutcome <= originalAlpha)
+    {
+        bound = BOUND_UPPER;
+    }
+    else if (bestOutcome >= beta)
+    {
+        bound = BOUND_LOWER;
+    }
+    else
+    {
+        bound = BOUND_EXACT;
+    }
+
+    weakTableStore(table, key, bestOutcome, bound, bestMove);
+
+    return bestOutcome;
+}
+
+
+/*
+ * Find whether a position is won, drawn or lost, and a move that keeps that
+ * outcome, by searching it to the end of the game with the window [-1, 1].
+ * The board must not be full. The score of the result is 1 for a win, 0 for
+ * a draw and -1 for a loss.
+ *
+ * params:
+ * pos: the position to solve, restored before returning
+ * table: the table of solved positions to use
+ * result: where the best move, the outcome and the statistics are stored
+ */
+void solveWeak(Position *pos, WeakTable *table, SearchResult *result)
+{
+    SearchContext ctx;
+    double startTime = getTime();
+    int moves[COLS];
+    int moveCount = 0;
+    int alpha = -1;
+    int outcome = 0;
+    int col = 0;
+    int i = 0;
+
+    memset(result, 0, sizeof(*result));
+    initSearchContext(&ctx, NULL, result);
+    result->nodes = 1;
+    result->score = -1;
+    moveCount = orderMoves(pos, &ctx, -1, moves);
+    result->bestMove = moves[0];
+
+    for (i = 0; i < moveCount && alpha < 1; i++)
+    {
+        col = moves[i];
+
+        if (isWinningMove(pos, col))
+        {
+            outcome = 1;
+        }
+        else
+        {
+            playMove(pos, col);
+            outcome = -weakNegamax(pos, -1, -alpha, table, &ctx);
+            undoMove(pos, col);
+        }
+
+        if (outcome > alpha)
+        {
+            alpha = outcome;
+            result->score = outcome;
+            result->bestMove = col;
+        }
+    }
+
+    result->depth = CELLS - pos->moves;
+    result->seconds = getTime() - startTime;
+}
+
+
+/*
+ * Read the way to solve a position from the end of its line.
+ *
+ * params:
+ * text: the rest of the line after the moves
+ * mode: where the way is stored; left alone if the text is blank
+ *
+ * returns:
+ * true if the text is blank or names a way to solve, false otherwise
+ */
+static bool parseSolveMode(const char *text, int *mode)
+{
+    size_t length = 0;
+    int i = 0;
+
+    text += strspn(text, " \t");
+    length = strcspn(text, " \t");
+
+    if (length == 0)
+    {
+        return true;
+    }
+
+    if (text[length + strspn(text + length, " \t")] != '\0')
+    {
+        return false;
+    }
+
+    for (i = 0; i < (int)(sizeof(solveModeNames) / sizeof(solveModeNames[0]));
+            i++)
+    {
+        if (strlen(solveModeNames[i]) == length
+                && strncmp(text, solveModeNames[i], length) == 0)
+        {
+            *mode = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*
+ * Solve lines of the batch until there are none left.
+ *
+ * params:
+ * arg: the BatchSolver
+ *
+ * returns:
+ * NULL
+ */
+static void *solveLines(void *arg)
+{
+    BatchSolver *solver = (BatchSolver *)arg;
+    SolveSlot *slot = NULL;
+    Position pos;
+    char moves[SOLVE_LINE_SIZE];
+    size_t length = 0;
+
+    pthread_mutex_lock(&solver->lock);
+
+    while (true)
+    {
+        while (solver->next == solver->head && !solver->endOfInput)
+        {
+            pthread_cond_wait(&solver->linesRead, &solver->lock);
+        }
+
+        if (solver->next == solver->head)
+        {
+            break;                  // every line has been handed out
+        }
+
+        slot = &solver->slots[solver->next++ % SOLVE_QUEUE_SIZE];
+        pthread_mutex_unlock(&solver->lock);
+
+        initPosition(&pos);
+        length = strcspn(slot->line, " \t");
+        memcpy(moves, slot->line, length);
+        moves[length] = '\0';
+        slot->mode = solver->mode;
+        slot->valid = length > 0
+                && parseSolveMode(slot->line + length, &slot->mode)
+                && playMoves(&pos, moves);
+
+        if (slot->valid && slot->mode == SOLVE_WEAK)
+        {
+            solveWeak(&pos, solver->weak, &slot->result);
+        }
+        else if (slot->valid && slot->mode == SOLVE_EXACT)
+        {
+            solveNullWindow(&pos, NULL, solver->tt, &slot->result);
+        }
+        else if (slot->valid)
+        {
+            solvePosition(&pos, solver->tt, &slot->result);
+        }
+
+        pthread_mutex_lock(&solver->lock);
+        slot->done = true;
+        pthread_cond_signal(&solver->lineSolved);
+    }
+
+    pthread_mutex_unlock(&solver->lock);
+    return NULL;
+}
+
+
+/*
+ * Read the next line of input into a slot, without its line ending. A line
+ * that is too long for the slot is read to its end and replaced with "?",
+ * which is never a valid position.
+ *
+ * params:
+ * input: the input stream
+ * slot: the slot to read into
+ *
+ * returns:
+ * true if a line was read, false at the end of the input
+ */
+static bool readLine(FILE *input, SolveSlot *slot)
+{
+    size_t length = 0;
+    int c = 0;
+
+    if (fgets(slot->line, SOLVE_LINE_SIZE, input) == NULL)
+    {
+        return false;
+    }
+
+    length = strlen(slot->line);
+
+    if (length > 0 && slot->line[length - 1] == '\n')
+    {
+        slot->line[--length] = '\0';
+
+        if (length > 0 && slot->line[length - 1] == '\r')
+        {
+            slot->line[--length] = '\0';
+        }
+    }
+    else if (!feof(input))
+    {
+        do
+        {
+            c = fgetc(input);
+        }
+        while (c != EOF && c != '\n');
+
+        strcpy(slot->line, "?");
+    }
+
+    return true;
+}
+
+
+/*
+ * Solve every position of an input stream and write the results, in the
+ * order of the input, as lines of:
+ *
+ * <line> <score> <best column>
+ *
+ * followed, for lines solved with null-window searches, by the number of
+ * searches the position took. The score of a line solved weakly is 1, 0 or
+ * -1. Lines that are not a position that can be played on from, or that end
+ * with an unknown way to solve, give "<line> invalid". Empty lines are
+ * invalid too, rather than taken as the empty board, which is far too slow
+ * to solve this way.
+ *
+ * params:
+ * input: the positions, one per line
+ * output: where the results are written
+ * tt: the transposition table shared by the workers
+ * weak: the table shared by the workers when solving weakly
+ * threads: number of worker threads
+ * mode: how lines that do not say are solved, from enum solveMode
+ *
+ * returns:
+ * true if the input was solved, false if the workers could not be started
+ */
+bool solveStream(FILE *input, FILE *output, TranspositionTable *tt,
+        WeakTable *weak, int threads, int mode)
+{
+    BatchSolver solver;
+    pthread_t *workers = NULL;
+    SolveSlot *slot = NULL;
+    unsigned long tail = 0;         // number of lines written
+    int started = 0;
+    int i = 0;
+
+    memset(&solver, 0, sizeof(solver));
+    solver.tt = tt;
+    solver.weak = weak;
+    solver.mode = mode;
+    solver.slots = (SolveSlot *)calloc(SOLVE_QUEUE_SIZE, sizeof(SolveSlot));
+    workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+
+    if (solver.slots == NULL || workers == NULL)
+    {
+        free(solver.slots);
+        free(workers);
+        return false;
+    }
+
+    pthread_mutex_init(&solver.lock, NULL);
+    pthread_cond_init(&solver.linesRead, NULL);
+    pthread_cond_init(&solver.lineSolved, NULL);
+
+    for (i = 0; i < threads; i++)
+    {
+        if (pthread_create(&workers[started], NULL, solveLines, &solver) == 0)
+        {
+            started++;
+        }
+    }
+
+    pthread_mutex_lock(&solver.lock);
+
+    while (started > 0 && (!solver.endOfInput || tail < solver.head))
+    {
+        slot = &solver.slots[tail % SOLVE_QUEUE_SIZE];
+
+        if (tail < solver.head && slot->done)
+        {
+            /* Only the main thread touches a slot once it is solved */
+            pthread_mutex_unlock(&solver.lock);
+
+            if (slot->valid && slot->mode == SOLVE_WEAK)
+            {
+                fprintf(output, "%s %d %d\n", slot->line, slot->result.score,
+                        slot->result.bestMove + 1);
+            }
+            else if (slot->valid && slot->mode == SOLVE_EXACT)
+            {
+                fprintf(output, "%s %d %d %d\n", slot->line,
+                        solvedScore(slot->result.score),
+                        slot->result.bestMove + 1, slot->result.researches);
+            }
+            else if (slot->valid)
+            {
+                fprintf(output, "%s %d %d\n", slot->line,
+                        solvedScore(slot->result.score),
+                        slot->result.bestMove + 1);
+            }
+            else
+            {
+                fprintf(output, "%s invalid\n", slot->line);
+            }
+
+            pthread_mutex_lock(&solver.lock);
+            tail++;
+        }
+        else if (!solver.endOfInput
+                && solver.head - tail < SOLVE_QUEUE_SIZE)
+        {
+            slot = &solver.slots[solver.head % SOLVE_QUEUE_SIZE];
+            pthread_mutex_unlock(&solver.lock);
+
+            /* The slot is free, so no worker looks at it while it is read */
+            slot->done = false;
+
+            if (tail == solver.head)
+            {
+                fflush(output);     // show every result before input blocks
+            }
+
+            if (readLine(input, slot))
+            {
+                pthread_mutex_lock(&solver.lock);
+                solver.head++;
+                pthread_cond_signal(&solver.linesRead);
+            }
+            else
+            {
+                pthread_mutex_lock(&solver.lock);
+                solver.endOfInput = true;
+                pthread_cond_broadcast(&solver.linesRead);
+            }
+        }
+        else
+        {
+            pthread_cond_wait(&solver.lineSolved, &solver.lock);
+        }
+    }
+
+    solver.endOfInput = true;
+    pthread_cond_broadcast(&solver.linesRead);
+    pthread_mutex_unlock(&solver.lock);
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&solver.lineSolved);
+    pthread_cond_destroy(&solver.linesRead);
+    pthread_mutex_destroy(&solver.lock);
+    free(workers);
+    free(solver.slots);
+    fflush(output);
+
+    return started > 0;
+}
+
+
+/*
+ * Compare the speed of the weak and the strong solvers over a fixed set of
+ * positions. Each position is solved from empty tables, so both solvers do
+ * the whole job.
+ *
+ * params:
+ * engine: the computer player whose tables are used
+ */
+void benchmarkWeak(Engine *engine)
+{
+    int positionCount = sizeof(benchWeakPositions)
+            / sizeof(benchWeakPositions[0]);
+    double totalSeconds[2] = {0, 0};
+    SearchResult strong;
+    SearchResult weak;
+    Position pos;
+    int i = 0;
+
+    printf("%-20s %6s %10s %10s %8s\n", "Position", "Score", "Strong",
+            "Weak", "Speedup");
+
+    for (i = 0; i < positionCount; i++)
+    {
+        initPosition(&pos);
+
+        if (!playMoves(&pos, benchWeakPositions[i]))
+        {
+            continue;               // too many columns for this board size
+        }
+
+        ttClear(&engine->tt);
+        solvePosition(&pos, &engine->tt, &strong);
+        weakTableClear(&engine->weak);
+        solveWeak(&pos, &engine->weak, &weak);
+        totalSeconds[0] += strong.seconds;
+        totalSeconds[1] += weak.seconds;
+
+        printf("%-20s %6d %9.3fs %9.3fs %7.2fx\n", benchWeakPositions[i],
+                solvedScore(strong.score), strong.seconds, weak.seconds,
+                strong.seconds / weak.seconds);
+    }
+
+    printf("%-20s %6s %9.3fs %9.3fs %7.2fx\n", "Total", "",
+            totalSeconds[0], totalSeconds[1],
+            totalSeconds[0] / totalSeconds[1]);
+}
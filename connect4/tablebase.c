@@ -0,0 +1,518 @@
+/*
+ * Endgame tablebase: the exact outcome of positions with few empty cells.
+ *
+ * A tablebase is built from a root position by collecting every position
+ * reachable from it, one ply at a time, and keeping those with at most a
+ * given number of empty cells. Their outcomes are then worked out backwards
+ * from the last ply: a position is worth the best of its moves, and the
+ * worth of every move is known from the ply after it. No search is needed.
+ * A position and its mirror image are worth the same, so they share a key
+ * and only one of them is kept, which about halves the tablebase.
+ *
+ * The number of positions grows quickly with the number of empty cells and
+ * with the distance from the root, so on a 7x6 board the root has to be a
+ * position well into the game. Small boards can be built from the start.
+ *
+ * The file has the layout of an opening book, with one byte per outcome:
+ *
+ * TablebaseHeader | uint64_t keys[count] | int8_t values[count]
+ *
+ * A value is 0 for a draw, and otherwise the number of cells still empty
+ * when the game is won, plus one, positive if the player to move wins and
+ * negative if they lose. The file is mapped into memory like a book, and a
+ * probe is a binary search of the keys.
+ */
+
+
+#include "c4.h"
+
+
+#define TABLEBASE_MAGIC "C4TB"  // identifies an endgame tablebase file
+#define TABLEBASE_VERSION 2     // version of the tablebase file layout
+
+
+/* Start of an endgame tablebase file */
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;                  // board size the tablebase was built for
+    uint32_t cols;
+    uint32_t empty;                 // most empty cells of a position held
+    uint32_t reserved;
+    uint64_t count;                 // number of positions in the tablebase
+}
+TablebaseHeader;
+
+
+/* A position collected while building a tablebase */
+typedef struct
+{
+    uint64_t key;
+    Position pos;
+    int8_t value;                   // outcome, once worked out
+}
+TablebaseEntry;
+
+
+/*
+ * Order two tablebase entries by their position key, for qsort().
+ *
+ * params:
+ * a: the first entry
+ * b: the second entry
+ *
+ * returns:
+ * a negative number, zero or a positive number if the key of the first
+ * entry is less than, equal to or greater than the key of the second
+ */
+static int compareEntries(const void *a, const void *b)
+{
+    uint64_t keyA = ((const TablebaseEntry *)a)->key;
+    uint64_t keyB = ((const TablebaseEntry *)b)->key;
+
+    return (keyA > keyB) - (keyA < keyB);
+}
+
+
+/*
+ * Find a key in an ascending list of keys.
+ *
+ * params:
+ * keys: the keys, which may be spread through an array of structures
+ * stride: bytes from one key to the next
+ * count: number of keys
+ * key: the key to find
+ *
+ * returns:
+ * the index of the key, or count if it is not in the list
+ */
+static size_t findKey(const void *keys, size_t stride, size_t count,
+        uint64_t key)
+{
+    const char *base = (const char *)keys;
+    size_t low = 0;
+    size_t high = count;
+    size_t middle = 0;
+
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (*(const uint64_t *)(base + middle * stride) < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low < count && *(const uint64_t *)(base + low * stride) == key)
+    {
+        return low;
+    }
+
+    return count;
+}
+
+
+/*
+ * Open a tablebase file and map it into memory.
+ *
+ * params:
+ * tablebase: the tablebase to open
+ * path: the tablebase file
+ *
+ * returns:
+ * true if the tablebase was opened, false otherwise
+ */
+bool tablebaseOpen(Tablebase *tablebase, const char *path)
+{
+    const TablebaseHeader *header = NULL;
+    struct stat fileInfo;
+    size_t expectedSize = 0;
+    void *map = MAP_FAILED;
+    int fd = -1;
+
+    memset(tablebase, 0, sizeof(*tablebase));
+
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    if (fstat(fd, &fileInfo) == 0
+            && (size_t)fileInfo.st_size >= sizeof(TablebaseHeader))
+    {
+        map = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);                  // the mapping stays valid without the file
+
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: not an endgame tablebase\n", path);
+        return false;
+    }
+
+    header = (const TablebaseHeader *)map;
+    expectedSize = sizeof(TablebaseHeader) + header->count
+            * (sizeof(uint64_t) + sizeof(int8_t));
+
+    if (memcmp(header->magic, TABLEBASE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != TABLEBASE_VERSION
+            || header->rows != ROWS || header->cols != COLS
+            || (size_t)fileInfo.st_size != expectedSize)
+    {
+        fprintf(stderr, "%s: not an endgame tablebase for a %dx%d board\n",
+                path, COLS, ROWS);
+        munmap(map, fileInfo.st_size);
+        return false;
+    }
+
+    tablebase->map = map;
+    tablebase->mapSize = fileInfo.st_size;
+    tablebase->count = header->count;
+    tablebase->empty = header->empty;
+    tablebase->keys = (const uint64_t *)(header + 1);
+    tablebase->values = (const int8_t *)(tablebase->keys + tablebase->count);
+
+    return true;
+}
+
+
+/*
+ * Unmap a tablebase. Closing a tablebase that was never opened does
+ * nothing.
+ *
+ * params:
+ * tablebase: the tablebase to close
+ */
+void tablebaseClose(Tablebase *tablebase)
+{
+    if (tablebase->map != NULL)
+    {
+        munmap(tablebase->map, tablebase->mapSize);
+    }
+
+    memset(tablebase, 0, sizeof(*tablebase));
+}
+
+
+/*
+ * Look up the exact score of a position in a tablebase.
+ *
+ * params:
+ * tablebase: the tablebase
+ * pos: the position
+ * score: where the score is stored if the position is found, on the scale
+ *        of the search, as if it had been searched to the end of the game
+ *
+ * returns:
+ * true if the position is in the tablebase, false otherwise
+ */
+bool tablebaseProbe(const Tablebase *tablebase, const Position *pos,
+        int *score)
+{
+    size_t index = 0;
+    int value = 0;
+
+    if (CELLS - pos->moves > tablebase->empty)
+    {
+        return false;
+    }
+
+    index = findKey(tablebase->keys, sizeof(uint64_t), tablebase->count,
+            canonicalKey(pos, NULL));
+
+    if (index == tablebase->count)
+    {
+        return false;
+    }
+
+    value = tablebase->values[index];
+
+    if (value > 0)
+    {
+        *score = WIN_SCORE - CELLS - 1 + value;
+    }
+    else if (value < 0)
+    {
+        *score = -(WIN_SCORE - CELLS - 1) + value;
+    }
+    else
+    {
+        *score = 0;
+    }
+
+    return true;
+}
+
+
+/*
+ * Collect the positions one move after a ply of positions. Moves that win
+ * end the game, so the positions they lead to are left out.
+ *
+ * params:
+ * ply: the positions of the ply, sorted by key
+ * count: the number of positions of the ply
+ * nextCount: where the number of positions collected is stored
+ *
+ * returns:
+ * the positions of the next ply sorted by key without duplicates, or NULL
+ * if there was not enough memory
+ */
+static TablebaseEntry *nextPly(const TablebaseEntry *ply, size_t count,
+        size_t *nextCount)
+{
+    TablebaseEntry *next = NULL;
+    TablebaseEntry *shrunk = NULL;
+    size_t children = 0;
+    size_t unique = 0;
+    size_t i = 0;
+    int col = 0;
+
+    next = (TablebaseEntry *)malloc((count * COLS + 1)
+            * sizeof(TablebaseEntry));
+
+    if (next == NULL)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        for (col = 0; col < COLS; col++)
+        {
+            if (!canPlay(&ply[i].pos, col)
+                    || isWinningMove(&ply[i].pos, col))
+            {
+                continue;
+            }
+
+            next[children].pos = ply[i].pos;
+            playMove(&next[children].pos, col);
+            next[children].key = canonicalKey(&next[children].pos, NULL);
+            next[children].value = 0;
+            children++;
+        }
+    }
+
+    qsort(next, children, sizeof(TablebaseEntry), compareEntries);
+
+    for (i = 0; i < children; i++)
+    {
+        if (unique == 0 || next[i].key != next[unique - 1].key)
+        {
+            next[unique++] = next[i];
+        }
+    }
+
+    /* Give back the room of the duplicates */
+    shrunk = (TablebaseEntry *)realloc(next,
+            (unique + 1) * sizeof(TablebaseEntry));
+
+    *nextCount = unique;
+    return shrunk != NULL ? shrunk : next;
+}
+
+
+/*
+ * Work out the outcome of a position from the outcomes of the next ply.
+ *
+ * params:
+ * pos: the position, restored before returning
+ * next: the positions of the next ply with their outcomes, sorted by key
+ * nextCount: the number of positions of the next ply
+ *
+ * returns:
+ * the outcome of the position, as stored in a tablebase
+ */
+static int8_t solveEntry(Position *pos, const TablebaseEntry *next,
+        size_t nextCount)
+{
+    int best = -MAX_TABLEBASE_EMPTY - 1;
+    int value = 0;
+    int col = 0;
+
+    for (col = 0; col < COLS; col++)
+    {
+        if (canPlay(pos, col) && isWinningMove(pos, col))
+        {
+            return CELLS - pos->moves;
+        }
+    }
+
+    for (col = 0; col < COLS; col++)
+    {
+        if (!canPlay(pos, col))
+        {
+            continue;
+        }
+
+        value = 0;                  // filling the board draws
+
+        if (pos->moves + 1 < CELLS)
+        {
+            playMove(pos, col);
+            value = -next[findKey(&next->key, sizeof(TablebaseEntry),
+                    nextCount, canonicalKey(pos, NULL))].value;
+            undoMove(pos, col);
+        }
+
+        if (value > best)
+        {
+            best = value;
+        }
+    }
+
+    return best;
+}
+
+
+/*
+ * Build the tablebase of every position reachable from a root position
+ * with at most a given number of empty cells, and write it to a file.
+ *
+ * params:
+ * path: the tablebase file to write
+ * root: the position to start from, which must not be full
+ * empty: the most empty cells of a position in the tablebase
+ *
+ * returns:
+ * true if the tablebase was written, false otherwise
+ */
+bool tablebaseBuild(const char *path, const Position *root, int empty)
+{
+    TablebaseHeader header = {TABLEBASE_MAGIC, TABLEBASE_VERSION, ROWS, COLS,
+            0, 0, 0};
+    TablebaseEntry *plies[CELLS] = {NULL};  // positions of each ply
+    size_t counts[CELLS] = {0};
+    TablebaseEntry *entries = NULL;         // every stored position
+    size_t count = 0;
+    size_t i = 0;
+    int firstPly = root->moves;
+    int storedPly = CELLS - empty;          // first ply that is stored
+    int ply = 0;
+    bool ready = true;
+    bool written = false;
+    FILE *file = NULL;
+
+    if (storedPly < firstPly)
+    {
+        storedPly = firstPly;
+    }
+
+    plies[firstPly] = (TablebaseEntry *)malloc(sizeof(TablebaseEntry));
+    ready = plies[firstPly] != NULL;
+
+    if (ready)
+    {
+        plies[firstPly][0].pos = *root;
+        plies[firstPly][0].key = canonicalKey(root, NULL);
+        counts[firstPly] = 1;
+    }
+
+    /* Collect the positions ply by ply, keeping only the stored plies and
+       the one the next is collected from */
+    for (ply = firstPly; ready && ply + 1 < CELLS; ply++)
+    {
+        plies[ply + 1] = nextPly(plies[ply], counts[ply], &counts[ply + 1]);
+        ready = plies[ply + 1] != NULL;
+
+        if (ply < storedPly)
+        {
+            free(plies[ply]);
+            plies[ply] = NULL;
+        }
+
+        if (ready)
+        {
+            fprintf(stderr, "Ply %d: %zu positions\n", ply + 1,
+                    counts[ply + 1]);
+        }
+    }
+
+    /* Work the outcomes out from the last ply back */
+    for (ply = CELLS - 1; ready && ply >= storedPly; ply--)
+    {
+        for (i = 0; i < counts[ply]; i++)
+        {
+            plies[ply][i].value = solveEntry(&plies[ply][i].pos,
+                    ply + 1 < CELLS ? plies[ply + 1] : NULL,
+                    ply + 1 < CELLS ? counts[ply + 1] : 0);
+        }
+
+        count += counts[ply];
+    }
+
+    if (ready)
+    {
+        entries = (TablebaseEntry *)malloc((count + 1)
+                * sizeof(TablebaseEntry));
+        ready = entries != NULL;
+        count = 0;
+    }
+
+    for (ply = storedPly; ready && ply < CELLS; ply++)
+    {
+        memcpy(entries + count, plies[ply],
+                counts[ply] * sizeof(TablebaseEntry));
+        count += counts[ply];
+    }
+
+    for (ply = 0; ply < CELLS; ply++)
+    {
+        free(plies[ply]);
+    }
+
+    if (!ready)
+    {
+        fprintf(stderr, "Not enough memory to build the tablebase\n");
+        free(entries);
+        return false;
+    }
+
+    /* Positions of different plies never share a key, so the stored plies
+       can be sorted into tablebase order at once */
+    qsort(entries, count, sizeof(TablebaseEntry), compareEntries);
+
+    file = fopen(path, "wb");
+
+    if (file != NULL)
+    {
+        header.empty = CELLS - storedPly;
+        header.count = count;
+        written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+        for (i = 0; i < count && written; i++)
+        {
+            written = fwrite(&entries[i].key, sizeof(uint64_t), 1, file) == 1;
+        }
+
+        for (i = 0; i < count && written; i++)
+        {
+            written = fwrite(&entries[i].value, sizeof(int8_t), 1, file) == 1;
+        }
+
+        written = (fclose(file) == 0) && written;
+    }
+
+    if (!written)
+    {
+        perror(path);
+    }
+    else
+    {
+        fprintf(stderr, "Wrote %zu positions with at most %d empty cells\n",
+                count, CELLS - storedPly);
+    }
+
+    free(entries);
+    return written;
+}
@@ -0,0 +1,388 @@
+/*
+ * Headless engine-against-engine games.
+ *
+ * A tournament plays a number of games between two computer players, A and
+ * B, spread over several threads. The players take turns to move first, and
+ * the first few moves of every game can be played at random so that games
+ * between deterministic players do not all repeat each other.
+ *
+ * Each finished game is written to the log file as a game record (see
+ * record.c), in the order games finish, so the games can be annotated
+ * later. The players are named after their descriptions, with "A:" or "B:"
+ * in front, such as "A:depth:8".
+ */
+
+
+#include "c4.h"
+
+
+/* Tournament state shared by the game threads */
+typedef struct
+{
+    const Tournament *settings;
+    atomic_int nextGame;            // number of the next game to start
+    pthread_mutex_t lock;           // guards the counts and the log file
+    FILE *log;
+    unsigned long wins[2];          // games won by player A and player B
+    unsigned long draws;
+    unsigned long totalMoves;
+}
+TournamentState;
+
+
+/* One game thread with a transposition table for each player, and nodes
+   for each Monte Carlo player */
+typedef struct
+{
+    pthread_t thread;
+    TournamentState *state;
+    TranspositionTable tt[2];
+    MctsTree tree[2];
+    unsigned int seed;              // random number state of the thread
+}
+GameThread;
+
+
+/*
+ * Read a player description: "random", "depth:N", "time:MS" or "mcts:MS".
+ *
+ * params:
+ * spec: the description
+ * player: where the player is stored
+ *
+ * returns:
+ * true if the description was valid, false otherwise
+ */
+bool parsePlayerSpec(const char *spec, PlayerSpec *player)
+{
+    bool validSpec = false;
+
+    if (strcmp(spec, "random") == 0)
+    {
+        player->type = PLAYER_RANDOM;
+        player->value = 0;
+        validSpec = true;
+    }
+    else if (strncmp(spec, "depth:", 6) == 0)
+    {
+        player->type = PLAYER_DEPTH;
+        validSpec = parseOption(spec + 6, 1, CELLS, "Player depth",
+                &player->value);
+    }
+    else if (strncmp(spec, "time:", 5) == 0)
+    {
+        player->type = PLAYER_TIME;
+        validSpec = parseOption(spec + 5, 1, MAX_THINK_TIME, "Player time",
+                &player->value);
+    }
+    else if (strncmp(spec, "mcts:", 5) == 0)
+    {
+        player->type = PLAYER_MCTS;
+        validSpec = parseOption(spec + 5, 1, MAX_THINK_TIME, "Player time",
+                &player->value);
+    }
+    else
+    {
+        fprintf(stderr, "Unknown player: %s\n", spec);
+    }
+
+    return validSpec;
+}
+
+
+/*
+ * Write the name of a tournament player, as it is given on the command
+ * line, with the letter of the player in front.
+ *
+ * params:
+ * player: the player
+ * letter: 'A' or 'B'
+ * name: where the name is stored, RECORD_NAME_SIZE characters
+ */
+static void playerName(const PlayerSpec *player, char letter, char *name)
+{
+    static const char *types[] = {"", "random", "depth", "time", "mcts"};
+
+    if (player->type == PLAYER_RANDOM)
+    {
+        snprintf(name, RECORD_NAME_SIZE, "%c:random", letter);
+    }
+    else
+    {
+        snprintf(name, RECORD_NAME_SIZE, "%c:%s:%d", letter,
+                types[player->type], player->value);
+    }
+}
+
+
+/*
+ * Choose a random column that is not full.
+ *
+ * params:
+ * pos: the position, which must not be full
+ * seed: the random number state
+ *
+ * returns:
+ * the column
+ */
+static int randomMove(const Position *pos, unsigned int *seed)
+{
+    int col = 0;
+
+    do
+    {
+        col = rand_r(seed) % COLS;
+    }
+    while (!canPlay(pos, col));
+
+    return col;
+}
+
+
+/*
+ * Choose the move of a player.
+ *
+ * params:
+ * pos: the position, which must not be full
+ * player: the player to move
+ * tt: the player's transposition table
+ * tree: the player's Monte Carlo nodes
+ * seed: the random number state
+ *
+ * returns:
+ * the column
+ */
+static int playerMove(Position *pos, const PlayerSpec *player,
+        TranspositionTable *tt, MctsTree *tree, unsigned int *seed)
+{
+    SearchLimits limits = {.threads = 1};
+    SearchResult result;
+
+    if (player->type == PLAYER_RANDOM)
+    {
+        return randomMove(pos, seed);
+    }
+
+    if (player->type == PLAYER_DEPTH)
+    {
+        limits.depth = player->value;
+    }
+    else
+    {
+        limits.timeLimit = player->value;
+    }
+
+    if (player->type == PLAYER_MCTS)
+    {
+        mctsSearch(pos, tree, &limits, &result);
+    }
+    else
+    {
+        searchPosition(pos, &limits, tt, &result);
+    }
+
+    return result.bestMove;
+}
+
+
+/*
+ * Play games until the tournament has played the number of games asked
+ * for.
+ *
+ * params:
+ * arg: the GameThread
+ *
+ * returns:
+ * NULL
+ */
+static void *playGames(void *arg)
+{
+    GameThread *thread = (GameThread *)arg;
+    TournamentState *state = thread->state;
+    const Tournament *settings = state->settings;
+    char names[2][RECORD_NAME_SIZE];
+    GameRecord record;
+    Position pos;
+    int game = 0;
+    int first = 0;                  // player moving first: 0 for A, 1 for B
+    int side = 0;                   // player to move: 0 for A, 1 for B
+    int winner = -1;
+    int col = 0;
+
+    playerName(&settings->players[0], 'A', names[0]);
+    playerName(&settings->players[1], 'B', names[1]);
+
+    while ((game = atomic_fetch_add(&state->nextGame, 1)) < settings->games)
+    {
+        initPosition(&pos);
+        first = game % 2;
+        winner = -1;
+        recordStart(&record, names[first], names[first ^ 1]);
+
+        while (winner < 0 && !isBoardFull(&pos))
+        {
+            side = (first + pos.moves) % 2;
+
+            if ((int)pos.moves < settings->randomPlies)
+            {
+                col = randomMove(&pos, &thread->seed);
+            }
+            else
+            {
+                col = playerMove(&pos, &settings->players[side],
+                        &thread->tt[side], &thread->tree[side],
+                        &thread->seed);
+            }
+
+            recordMove(&record, col);
+
+            if (placePiece(&pos, col))
+            {
+                winner = side;
+            }
+        }
+
+        recordResult(&record, &pos, winner >= 0);
+
+        pthread_mutex_lock(&state->lock);
+
+        if (winner < 0)
+        {
+            state->draws++;
+        }
+        else
+        {
+            state->wins[winner]++;
+        }
+
+        state->totalMoves += pos.moves;
+
+        if (state->log != NULL)
+        {
+            recordWrite(state->log, &record);
+        }
+
+        pthread_mutex_unlock(&state->lock);
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Play a tournament and show its results: the win, draw and loss rates of
+ * player A, and the number of games played per second.
+ *
+ * The transposition table memory is split evenly between the two tables of
+ * every thread, with at least 1 MB per table. A Monte Carlo player gets as
+ * much again for its nodes, instead of a table.
+ *
+ * params:
+ * settings: the players, number of games, threads, and log file
+ *
+ * returns:
+ * true if the tournament was played, false otherwise
+ */
+bool runTournament(const Tournament *settings)
+{
+    TournamentState state;
+    GameThread *threads = NULL;
+    size_t tableSize = settings->ttSize / (2 * settings->threads);
+    double startTime = 0;
+    double seconds = 0;
+    unsigned long played = 0;
+    int started = 0;
+    int i = 0;
+    bool ready = true;
+
+    memset(&state, 0, sizeof(state));
+    state.settings = settings;
+    atomic_init(&state.nextGame, 0);
+    pthread_mutex_init(&state.lock, NULL);
+
+    if (tableSize == 0)
+    {
+        tableSize = 1;
+    }
+
+    if (settings->logFile != NULL)
+    {
+        state.log = fopen(settings->logFile, "w");
+
+        if (state.log == NULL)
+        {
+            perror(settings->logFile);
+            return false;
+        }
+    }
+
+    threads = (GameThread *)calloc(settings->threads, sizeof(GameThread));
+    ready = threads != NULL;
+
+    for (i = 0; ready && i < settings->threads; i++)
+    {
+        threads[i].state = &state;
+        threads[i].seed = (unsigned int)time(NULL) * (i + 1) + i;
+        ready = ttInit(&threads[i].tt[0], settings->players[0].type
+                    == PLAYER_MCTS ? 0 : tableSize)
+                && ttInit(&threads[i].tt[1], settings->players[1].type
+                    == PLAYER_MCTS ? 0 : tableSize)
+                && (settings->players[0].type != PLAYER_MCTS
+                    || mctsInit(&threads[i].tree[0], tableSize, 1))
+                && (settings->players[1].type != PLAYER_MCTS
+                    || mctsInit(&threads[i].tree[1], tableSize, 1));
+    }
+
+    if (!ready)
+    {
+        fprintf(stderr, "Could not allocate the game threads\n");
+    }
+
+    startTime = getTime();
+
+    for (i = 0; ready && i < settings->threads; i++)
+    {
+        if (pthread_create(&threads[i].thread, NULL, playGames,
+                &threads[i]) == 0)
+        {
+            started++;
+        }
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+    }
+
+    seconds = getTime() - startTime;
+
+    for (i = 0; threads != NULL && i < settings->threads; i++)
+    {
+        ttFree(&threads[i].tt[0]);
+        ttFree(&threads[i].tt[1]);
+        mctsFree(&threads[i].tree[0]);
+        mctsFree(&threads[i].tree[1]);
+    }
+
+    free(threads);
+    pthread_mutex_destroy(&state.lock);
+
+    if (state.log != NULL && fclose(state.log) != 0)
+    {
+        perror(settings->logFile);
+    }
+
+    played = state.wins[0] + state.wins[1] + state.draws;
+
+    if (played > 0)
+    {
+        printf("%lu games in %.3f s (%.1f games/s, %.1f moves per game)\n"
+                "A wins %.1f%%, draws %.1f%%, A losses %.1f%%\n",
+                played, seconds, played / seconds,
+                (double)state.totalMoves / played,
+                100.0 * state.wins[0] / played, 100.0 * state.draws / played,
+                100.0 * state.wins[1] / played);
+    }
+
+    return ready && started > 0;
+}
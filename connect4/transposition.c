@@ -0,0 +1,376 @@
+/*
+ * Transposition table for the game tree search.
+ *
+ * The same position is often reached through different move orders, so the
+ * result of every searched position is stored in a fixed-size hash table
+ * keyed by the position key. A later search of the same position can then
+ * reuse the score, or at least try the stored best move first. The search
+ * uses the key shared by a position and its mirror image, so both find the
+ * same entry, and stores the best move as played in whichever of the two
+ * the key belongs to.
+ *
+ * The table has a power of two number of entries, so a key is mapped to its
+ * slot by masking its hash. Each slot holds one entry and a new entry always
+ * replaces the old one.
+ *
+ * Search threads share one table without locks. An entry is two words that
+ * are written separately, so a thread may read one word of an old entry and
+ * one of a new entry. To catch that, the key word holds the key XORed with
+ * the data word: a torn entry no longer XORs back to its own key and is
+ * treated as a miss.
+ *
+ * The weak solver, which only tells wins, draws and losses apart, has a
+ * table of its own with entries of one word. The low byte of the word packs
+ * the outcome, its bound and the best move, and the rest holds the hash of
+ * the key above the low byte. The slot gives the low bits of the hash, and
+ * the hash can be turned back into the key, so as long as the table has
+ * at least 256 slots an entry identifies its position exactly. Being one
+ * word, an entry can never be torn.
+ */
+
+
+#include "c4.h"
+
+
+/* Layout of the packed entry data */
+#define SCORE_BITS 16
+#define DEPTH_SHIFT 16
+#define BOUND_SHIFT 24
+#define MOVE_SHIFT 28
+
+/* Layout of the low byte of a weak table entry */
+#define WEAK_MOVE_BITS 0x0f     // best move plus one
+#define WEAK_BOUND_SHIFT 4
+#define WEAK_OUTCOME_SHIFT 6    // outcome plus one: 0, 1 or 2
+#define WEAK_DATA_MASK 0xff
+#define WEAK_MIN_ENTRIES 256    // fewest slots that identify a key exactly
+
+
+/*
+ * Mix the bits of a position key so that similar keys land in different
+ * slots.
+ *
+ * params:
+ * key: the position key
+ *
+ * returns:
+ * the hash of the key
+ */
+static inline uint64_t hashKey(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return key;
+}
+
+
+/*
+ * Allocate a table that fits in the given amount of memory. The number of
+ * entries is rounded down to a power of two.
+ *
+ * A size of 0 gives a table with no entries, which stores nothing.
+ *
+ * params:
+ * tt: the table to initialize
+ * megabytes: maximum size of the table in megabytes
+ *
+ * returns:
+ * true if the table was allocated, false otherwise
+ */
+bool ttInit(TranspositionTable *tt, size_t megabytes)
+{
+    size_t maxEntries = megabytes * 1024 * 1024 / sizeof(TTEntry);
+    size_t entries = 1;
+
+    tt->entries = NULL;
+    tt->mask = 0;
+
+    if (maxEntries == 0)
+    {
+        return true;
+    }
+
+    while (entries * 2 <= maxEntries)
+    {
+        entries *= 2;
+    }
+
+    tt->entries = (TTEntry *)calloc(entries, sizeof(TTEntry));
+
+    if (tt->entries != NULL)
+    {
+        tt->mask = entries - 1;
+    }
+
+    return tt->entries != NULL;
+}
+
+
+/*
+ * Free the memory of a table.
+ *
+ * params:
+ * tt: the table to free
+ */
+void ttFree(TranspositionTable *tt)
+{
+    free(tt->entries);
+    tt->entries = NULL;
+    tt->mask = 0;
+}
+
+
+/*
+ * Remove every entry from a table.
+ *
+ * params:
+ * tt: the table to clear
+ */
+void ttClear(TranspositionTable *tt)
+{
+    if (tt->entries != NULL)
+    {
+        memset(tt->entries, 0, (tt->mask + 1) * sizeof(TTEntry));
+    }
+}
+
+
+/*
+ * Look up a position in a table.
+ *
+ * A probe that finds its slot taken by a different position counts as a
+ * collision.
+ *
+ * params:
+ * tt: the table
+ * key: the position key
+ * data: where the stored entry is unpacked if it is found
+ * result: where the probe, hit and collision counts are kept
+ *
+ * returns:
+ * true if the position was found, false otherwise
+ */
+bool ttProbe(const TranspositionTable *tt, uint64_t key, TTData *data,
+        SearchResult *result)
+{
+    const TTEntry *entry = NULL;
+    uint64_t checkedKey = 0;
+    uint64_t packed = 0;
+
+    if (tt->entries == NULL)
+    {
+        return false;
+    }
+
+    result->ttProbes++;
+    entry = &tt->entries[hashKey(key) & tt->mask];
+    packed = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    checkedKey = atomic_load_explicit(&entry->key, memory_order_relaxed);
+
+    if (packed == 0)
+    {
+        return false;
+    }
+
+    if ((checkedKey ^ packed) != key)
+    {
+        result->ttCollisions++;
+        return false;
+    }
+
+    result->ttHits++;
+    data->score = (int16_t)(packed & ((1 << SCORE_BITS) - 1));
+    data->depth = (packed >> DEPTH_SHIFT) & 0xff;
+    data->bound = (packed >> BOUND_SHIFT) & 0x3;
+    data->bestMove = (int)((packed >> MOVE_SHIFT) & 0xf) - 1;
+
+    return true;
+}
+
+
+/*
+ * Store the result of searching a position in a table, replacing whatever
+ * was in its slot.
+ *
+ * params:
+ * tt: the table
+ * key: the position key
+ * score: the score of the position
+ * depth: the depth the position was searched to
+ * bound: whether the score is exact, a lower bound or an upper bound
+ * bestMove: the best move found, or -1 if none
+ */
+void ttStore(TranspositionTable *tt, uint64_t key, int score, int depth,
+        int bound, int bestMove)
+{
+    TTEntry *entry = NULL;
+    uint64_t packed = 0;
+
+    if (tt->entries == NULL)
+    {
+        return;
+    }
+
+    /* The bound is never BOUND_NONE, so a stored entry is never all zero */
+    packed = (uint64_t)(uint16_t)score
+            | (uint64_t)depth << DEPTH_SHIFT
+            | (uint64_t)bound << BOUND_SHIFT
+            | (uint64_t)(bestMove + 1) << MOVE_SHIFT;
+
+    entry = &tt->entries[hashKey(key) & tt->mask];
+    atomic_store_explicit(&entry->key, key ^ packed, memory_order_relaxed);
+    atomic_store_explicit(&entry->data, packed, memory_order_relaxed);
+}
+
+
+/*
+ * Allocate a weak solver table that fits in the given amount of memory. The
+ * number of entries is rounded down to a power of two, and a table too small
+ * to hold WEAK_MIN_ENTRIES entries has none, and stores nothing.
+ *
+ * params:
+ * table: the table to initialize
+ * megabytes: maximum size of the table in megabytes
+ *
+ * returns:
+ * true if the table was allocated, false otherwise
+ */
+bool weakTableInit(WeakTable *table, size_t megabytes)
+{
+    size_t maxEntries = megabytes * 1024 * 1024 / sizeof(uint64_t);
+    size_t entries = WEAK_MIN_ENTRIES;
+
+    table->entries = NULL;
+    table->mask = 0;
+
+    if (maxEntries < WEAK_MIN_ENTRIES)
+    {
+        return true;
+    }
+
+    while (entries * 2 <= maxEntries)
+    {
+        entries *= 2;
+    }
+
+    table->entries = (_Atomic uint64_t *)calloc(entries, sizeof(uint64_t));
+
+    if (table->entries != NULL)
+    {
+        table->mask = entries - 1;
+    }
+
+    return table->entries != NULL;
+}
+
+
+/*
+ * Free the memory of a weak solver table.
+ *
+ * params:
+ * table: the table to free
+ */
+void weakTableFree(WeakTable *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+    table->mask = 0;
+}
+
+
+/*
+ * Remove every entry from a weak solver table.
+ *
+ * params:
+ * table: the table to clear
+ */
+void weakTableClear(WeakTable *table)
+{
+    if (table->entries != NULL)
+    {
+        memset(table->entries, 0, (table->mask + 1) * sizeof(uint64_t));
+    }
+}
+
+
+/*
+ * Look up a position in a weak solver table.
+ *
+ * params:
+ * table: the table
+ * key: the position key
+ * outcome: where the stored outcome (1, 0 or -1) is put if found
+ * bound: where the bound of the outcome is put if found
+ * bestMove: where the stored best move, or -1, is put if found
+ * result: where the probe, hit and collision counts are kept
+ *
+ * returns:
+ * true if the position was found, false otherwise
+ */
+bool weakTableProbe(const WeakTable *table, uint64_t key, int *outcome,
+        int *bound, int *bestMove, SearchResult *result)
+{
+    uint64_t hash = hashKey(key);
+    uint64_t entry = 0;
+
+    if (table->entries == NULL)
+    {
+        return false;
+    }
+
+    result->ttProbes++;
+    entry = atomic_load_explicit(&table->entries[hash & table->mask],
+            memory_order_relaxed);
+
+    if (entry == 0)
+    {
+        return false;
+    }
+
+    if (((entry ^ hash) & ~(uint64_t)WEAK_DATA_MASK) != 0)
+    {
+        result->ttCollisions++;
+        return false;
+    }
+
+    result->ttHits++;
+    *outcome = (int)(entry >> WEAK_OUTCOME_SHIFT & 0x3) - 1;
+    *bound = entry >> WEAK_BOUND_SHIFT & 0x3;
+    *bestMove = (int)(entry & WEAK_MOVE_BITS) - 1;
+
+    return true;
+}
+
+
+/*
+ * Store the outcome of a position in a weak solver table, replacing
+ * whatever was in its slot.
+ *
+ * params:
+ * table: the table
+ * key: the position key
+ * outcome: 1 for a win, 0 for a draw, -1 for a loss
+ * bound: whether the outcome is exact, a lower bound or an upper bound
+ * bestMove: the best move found, or -1 if none
+ */
+void weakTableStore(WeakTable *table, uint64_t key, int outcome, int bound,
+        int bestMove)
+{
+    uint64_t hash = hashKey(key);
+
+    if (table->entries == NULL)
+    {
+        return;
+    }
+
+    /* The bound is never BOUND_NONE, so a stored entry is never zero */
+    atomic_store_explicit(&table->entries[hash & table->mask],
+            (hash & ~(uint64_t)WEAK_DATA_MASK)
+            | (uint64_t)(outcome + 1) << WEAK_OUTCOME_SHIFT
+            | (uint64_t)bound << WEAK_BOUND_SHIFT
+            | (uint64_t)(bestMove + 1), memory_order_relaxed);
+}